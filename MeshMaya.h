@@ -18,31 +18,38 @@ using namespace Tetrise;
 
 
 
+// get the mIndex-th input mesh
+MStatus getInputMesh(MDataBlock& data, MObject& input, MObject& inputGeom, unsigned int mIndex, MObject& mesh){
+    MStatus status;
+    MArrayDataHandle hInput = data.outputArrayValue( input, &status );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = hInput.jumpToElement( mIndex );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    mesh = hInput.outputValue().child( inputGeom ).asMesh();
+    return MS::kSuccess;
+}
+
 // get face list
 int makeFaceTet(MDataBlock& data, MObject& input, MObject& inputGeom, unsigned int mIndex, const std::vector<Vector3d>& pts,
                 std::vector<int>& tetList, std::vector<Matrix4d>& tetMatrix, std::vector<double>& tetWeight){
     // returns total number of pts including ghost ones
     // read mesh data
     int numPts = (int) pts.size();
-    MStatus status;
-    MArrayDataHandle hInput = data.outputArrayValue( input, &status );
-    CHECK_MSTATUS_AND_RETURN_IT( status );
-    status = hInput.jumpToElement( mIndex );
+    MObject oInputGeom;
+    MStatus status = getInputMesh(data, input, inputGeom, mIndex, oInputGeom);
     CHECK_MSTATUS_AND_RETURN_IT( status );
-    MObject oInputGeom = hInput.outputValue().child( inputGeom ).asMesh();
     MFnMesh inputMesh(oInputGeom);
     // face list
     MIntArray count, triangles;
     inputMesh.getTriangles( count, triangles );
-    std::vector<int> faceList(triangles.length());
+    MeshTopology topo;
+    topo.faceList.resize(triangles.length());
     for(int i=0;i<triangles.length();i++){
-        faceList[i]=triangles[i];
+        topo.faceList[i]=triangles[i];
     }
     //
-    std::vector<vertex> vList;
-    std::vector<edge> eList;
-    makeTetList(TM_FACE, numPts, faceList, eList, vList, tetList);
-    makeTetMatrix(TM_FACE, pts, tetList, faceList, eList, vList, tetMatrix, tetWeight);
+    makeTetList(TM_FACE, numPts, topo, tetList);
+    makeTetMatrix(TM_FACE, pts, tetList, topo, tetMatrix, tetWeight);
     return numPts + (int)tetList.size()/4;
 }
 
@@ -83,55 +90,202 @@ void makeFaceList(MObject& mesh, std::vector<int>& faceList, std::vector<int>& f
     }
 }
 
-// vertex list
-void makeVertexList(MObject& mesh, std::vector<vertex>& vertexList){
+// triangle fans around vertices; the fan of a vertex lists the neighbouring vertices of each polygon around it
+void makeVertexList(MObject& mesh, MeshTopology& topo){
     int numPts = MFnMesh(mesh).numVertices();
-    MItMeshPolygon iter(mesh);
     MIntArray faceVertices;
-    vertexList.resize(numPts);
+    topo.fanVertex.resize(numPts);
+    topo.fanOffset.assign(numPts+1, 0);
     for(int i=0;i<numPts;i++){
-        vertexList[i].index = i;
-        vertexList[i].connectedTriangles.clear();
+        topo.fanVertex[i] = i;
     }
-    for( ; ! iter.isDone(); iter.next()){
+    // count the polygons around each vertex
+    for(MItMeshPolygon iter(mesh); ! iter.isDone(); iter.next()){
+        iter.getVertices(faceVertices);
+        for(int j=0;j<faceVertices.length();j++){
+            topo.fanOffset[faceVertices[j]+1]++;
+        }
+    }
+    for(int i=0;i<numPts;i++){
+        topo.fanOffset[i+1] += topo.fanOffset[i];
+    }
+    // fill the fans in the order of polygons
+    topo.fanTriangle.resize(2*topo.fanOffset[numPts]);
+    std::vector<int> cur(topo.fanOffset.begin(), topo.fanOffset.end()-1);
+    for(MItMeshPolygon iter(mesh); ! iter.isDone(); iter.next()){
         iter.getVertices(faceVertices);
         int count = (int) faceVertices.length();
         for(int j=0;j<count;j++){
-            vertexList[faceVertices[j]].connectedTriangles.push_back(faceVertices[(j+1)%count]);
-            vertexList[faceVertices[j]].connectedTriangles.push_back(faceVertices[(j+count-1)%count]);
+            int k = cur[faceVertices[j]]++;
+            topo.fanTriangle[2*k] = faceVertices[(j+1)%count];
+            topo.fanTriangle[2*k+1] = faceVertices[(j+count-1)%count];
         }
     }
 }
 
-// get mesh data
-int getMeshData(MDataBlock& data, MObject& input, MObject& inputGeom, unsigned int mIndex,
-                short tetMode, const std::vector<Vector3d>& pts, std::vector<int>& tetList,
-                std::vector<int>& faceList, std::vector<edge>& edgeList,
-                std::vector<vertex>& vertexList, std::vector<Matrix4d>& tetMat, std::vector<double>& tetWeight){
-    // returns total number of pts including ghost ones
-    // read mesh data
-    int numPts = (int) pts.size();
-    MStatus status;
-    MArrayDataHandle hInput = data.outputArrayValue( input, &status );
-    CHECK_MSTATUS_AND_RETURN_IT( status );
-    status = hInput.jumpToElement( mIndex );
-    CHECK_MSTATUS_AND_RETURN_IT( status );
-    MObject oInputGeom = hInput.outputValue().child( inputGeom ).asMesh();
+// hash (FNV-1a) of the face connectivity of a mesh.
+// The triangulation is hashed as well, since that of n-gons may change with the vertex positions.
+unsigned long long connectivityHash(MObject& mesh){
+    MFnMesh fnMesh(mesh);
+    MIntArray count, connect;
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned long long prime = 1099511628211ULL;
+    hash = (hash ^ (unsigned long long)fnMesh.numVertices()) * prime;
+    fnMesh.getVertices(count, connect);
+    for(unsigned int i=0;i<count.length();i++){
+        hash = (hash ^ (unsigned long long)count[i]) * prime;
+    }
+    for(unsigned int i=0;i<connect.length();i++){
+        hash = (hash ^ (unsigned long long)connect[i]) * prime;
+    }
+    fnMesh.getTriangles(count, connect);
+    for(unsigned int i=0;i<connect.length();i++){
+        hash = (hash ^ (unsigned long long)connect[i]) * prime;
+    }
+    return hash;
+}
+
+// get mesh topology
+void getMeshTopology(MObject& mesh, MeshTopology& topo){
     std::vector<int> faceCount;
-    makeFaceList(oInputGeom, faceList, faceCount);
-    makeVertexList(oInputGeom, vertexList);
-    makeEdgeList(faceList, edgeList);
-    int dim=makeTetList(tetMode, numPts, faceList, edgeList, vertexList, tetList);
-    makeTetMatrix(tetMode, pts, tetList, faceList, edgeList, vertexList, tetMat, tetWeight);
-    return dim;
+    makeFaceList(mesh, topo.faceList, faceCount);
+    makeVertexList(mesh, topo);
+    makeEdgeList(topo);
 }
 
+// access to the points being deformed.
+// For a mesh deformed as a whole, the point buffer of the output mesh is read in place and the results are
+// written back at once with MFnMesh::setPoints from a persistent array;
+// otherwise (e.g., particles or partial deformer sets) it falls back to MItGeometry and MPointArray.
+class PointBuffer {
+public:
+    const float* raw;     // read only buffer of 3 floats per point, or NULL when the fallback is used
+    MFloatPointArray outPts;   // results for the mesh
+    MPointArray Mpts;     // fallback storage
+    MObject oMesh;
+    int numPts;
+    PointBuffer(): raw(NULL), numPts(0) {};
+    void read(MDataBlock& data, MObject& outputGeom, unsigned int mIndex, MItGeometry& itGeo);
+    void write(MItGeometry& itGeo);
+    Vector3d get(int i) const {
+        if(raw) return Vector3d(raw[3*i], raw[3*i+1], raw[3*i+2]);
+        return Vector3d(Mpts[i].x, Mpts[i].y, Mpts[i].z);
+    }
+    // the i-th point moved by mat (acting on row vectors), e.g. into world space
+    Vector3d get(int i, const Matrix4d& mat) const {
+        return mat.topLeftCorner<3,3>().transpose() * get(i) + mat.block<1,3>(3,0).transpose();
+    }
+    void set(int i, const RowVector4d& p){
+        if(raw){
+            outPts[i].x = (float) p[0];
+            outPts[i].y = (float) p[1];
+            outPts[i].z = (float) p[2];
+        }else{
+            Mpts[i].x = p[0];
+            Mpts[i].y = p[1];
+            Mpts[i].z = p[2];
+        }
+    }
+};
+
+void PointBuffer::read(MDataBlock& data, MObject& outputGeom, unsigned int mIndex, MItGeometry& itGeo){
+    MStatus status;
+    raw = NULL;
+    // the output geometry holds a copy of the input when deform() is called
+    MArrayDataHandle hOutput = data.outputArrayValue( outputGeom, &status );
+    if(status == MS::kSuccess && hOutput.jumpToElement( mIndex ) == MS::kSuccess){
+        oMesh = hOutput.outputValue().data();
+        if(oMesh.hasFn(MFn::kMesh)){
+            MFnMesh fnMesh(oMesh);
+            if(fnMesh.numVertices() == itGeo.exactCount()){
+                raw = fnMesh.getRawPoints(&status);
+                if(status != MS::kSuccess) raw = NULL;
+                numPts = fnMesh.numVertices();
+            }
+        }
+    }
+    if(raw == NULL){
+        itGeo.allPositions(Mpts);
+        numPts = Mpts.length();
+    }else if(outPts.length() != numPts){
+        outPts.setLength(numPts);
+    }
+}
+
+void PointBuffer::write(MItGeometry& itGeo){
+    if(raw){
+        MFnMesh(oMesh).setPoints(outPts);
+    }else{
+        itGeo.setAllPositions(Mpts);
+    }
+}
+
+// read the painted deformer weights of the mIndex-th geometry at once
+// returns true when all the weights are 1.0
+bool readPaintedWeight(MDataBlock& data, MObject& weightList, MObject& weights, unsigned int mIndex,
+                       MItGeometry& itGeo, std::vector<double>& w){
+    MStatus status;
+    // component indices of the deformed points
+    std::vector<int> index;
+    index.reserve(itGeo.exactCount());
+    int maxIndex = -1;
+    for(itGeo.reset(); !itGeo.isDone(); itGeo.next()){
+        index.push_back(itGeo.index());
+        maxIndex = std::max(maxIndex, index.back());
+    }
+    itGeo.reset();
+    // unpainted entries are not stored and default to 1.0
+    std::vector<double> painted(maxIndex+1, 1.0);
+    MArrayDataHandle hWeightList = data.inputArrayValue(weightList, &status);
+    if(status == MS::kSuccess && hWeightList.jumpToElement(mIndex) == MS::kSuccess){
+        MArrayDataHandle hWeights = hWeightList.inputValue().child(weights);
+        int numElements = hWeights.elementCount();
+        for(int i=0;i<numElements;i++){
+            hWeights.jumpToArrayElement(i);
+            int idx = hWeights.elementIndex();
+            if(idx <= maxIndex) painted[idx] = hWeights.inputValue().asFloat();
+        }
+    }
+    bool isUniform = true;
+    w.resize(index.size());
+    for(int i=0;i<index.size();i++){
+        w[i] = painted[index[i]];
+        isUniform = isUniform && (w[i] == 1.0);
+    }
+    return isUniform;
+}
+
+// lookup table sampled from a ramp attribute
+class RampLUT {
+public:
+    std::vector<float> table;   // values at equally spaced positions in [0,1]
+    RampLUT() {};
+    void sample(MRampAttribute& ramp, int resolution){
+        resolution = std::max(resolution, 2);
+        table.resize(resolution);
+        for(int i=0;i<resolution;i++){
+            ramp.getValueAtPosition((float)i/(resolution-1), table[i]);
+        }
+    }
+    // linearly interpolated value; positions outside [0,1] are clamped as MRampAttribute does
+    double operator()(double x) const {
+        double t = x * (table.size()-1);
+        if(!(t > 0.0)) return table.front();
+        if(t >= table.size()-1) return table.back();
+        int k = (int) t;
+        double s = t - k;
+        return (1.0-s) * table[k] + s * table[k+1];
+    }
+};
+
 // visualise vertex assigned values
-void visualise(MDataBlock& data, MObject& outputGeom, std::vector<double>& ptsColour){
+void visualise(MDataBlock& data, MObject& outputGeom, unsigned int mIndex, std::vector<double>& ptsColour){
     // load target mesh output
     MStatus status;
     MArrayDataHandle outputArray = data.outputArrayValue(outputGeom , &status );
-    MDataHandle hOutput = outputArray.inputValue(&status);
+    status = outputArray.jumpToElement(mIndex);
+    if(status != MS::kSuccess) return;
+    MDataHandle hOutput = outputArray.outputValue(&status);
     MFnMesh outMesh(hOutput.data());
     MColorArray Colours;
     MIntArray Index;
@@ -144,18 +298,23 @@ void visualise(MDataBlock& data, MObject& outputGeom, std::vector<double>& ptsCo
     outMesh.setVertexColors(Colours, Index);
 }
 
+// convert Maya's matrix to Eigen matrix (both act on row vectors)
+Matrix4d toMatrix4d(const MMatrix& mat){
+    Matrix4d m;
+    m << mat(0,0), mat(0,1), mat(0,2), mat(0,3),
+    mat(1,0), mat(1,1), mat(1,2), mat(1,3),
+    mat(2,0), mat(2,1), mat(2,2), mat(2,3),
+    mat(3,0), mat(3,1), mat(3,2), mat(3,3);
+    return m;
+}
+
 // read array of matrix attributes and convert them to Eigen matrices
 void readMatrixArray(MArrayDataHandle& handle, std::vector<Matrix4d>& m){
     int numPrb=handle.elementCount();
     m.resize(numPrb);
-    MMatrix mat;
     for(int i=0;i<numPrb;i++){
         handle.jumpToArrayElement(i);
-        mat=handle.inputValue().asMatrix();
-        m[i] << mat(0,0), mat(0,1), mat(0,2), mat(0,3),
-        mat(1,0), mat(1,1), mat(1,2), mat(1,3),
-        mat(2,0), mat(2,1), mat(2,2), mat(2,3),
-        mat(3,0), mat(3,1), mat(3,2), mat(3,3);
+        m[i] = toMatrix4d(handle.inputValue().asMatrix());
     }
 }
 
@@ -35,18 +35,104 @@ MObject probeDeformerNode::aNormExponent;
 MObject probeDeformerNode::aProbeWeight;
 MObject probeDeformerNode::aVisualisationMode;
 MObject probeDeformerNode::aComputeWeight;
+MObject probeDeformerNode::aPaintedWeight;
+MObject probeDeformerNode::aRampLUT;
+MObject probeDeformerNode::aRampResolution;
 MObject probeDeformerNode::aVisualisationMultiplier;
 MObject probeDeformerNode::aNormaliseWeight;
+MObject probeDeformerNode::aWeightPrecision;
+MObject probeDeformerNode::aWeightMemory;
+MObject probeDeformerNode::aWeightStorage;
 MObject probeDeformerNode::aAreaWeighted;
 MObject probeDeformerNode::aNeighbourWeighting;
+MObject probeDeformerNode::aSolver;
+MObject probeDeformerNode::aFactorisationTime;
+MObject probeDeformerNode::aFactorisationMemory;
+
+// stores the solutions of the harmonic weighting on the points into the weight table
+struct HarmonicStore {
+    ProbeWeight& W;
+    HarmonicStore(ProbeWeight& _W): W(_W) {};
+    void operator()(int first, const MatrixXd& X){
+        for(int c=0;c<X.cols();c++){
+            for(int j=0;j<W.numElem;j++){
+                W.set(WC_ROTATION, j, first+c, X(j,c));
+            }
+        }
+    }
+};
 
 void* probeDeformerNode::creator() { return new probeDeformerNode; }
+
+// get the cache for the mIndex-th geometry
+probeDeformerGeom& probeDeformerNode::getGeom(MDataBlock& data, unsigned int mIndex){
+    geomLock.lock();
+    probeDeformerGeom& G = geom[mIndex];
+    // dirtiness of the node is handed over to every geometry
+    bool isWeightDirty = !data.isClean(aComputeWeight);
+    bool isPaintDirty = !data.isClean(aPaintedWeight);
+    std::map<unsigned int, probeDeformerGeom>::iterator iter;
+    for(iter = geom.begin(); iter != geom.end(); iter++){
+        iter->second.isWeightDirty |= isWeightDirty;
+        iter->second.isPaintDirty |= isPaintDirty;
+    }
+    if(isWeightDirty) data.setClean(aComputeWeight);
+    if(isPaintDirty) data.setClean(aPaintedWeight);
+    geomLock.unlock();
+    return G;
+}
+
+// sample the ramp curves into lookup tables when they are changed, and hand a copy to the geometry,
+// which reads it without the lock while other geometries may resample
+void probeDeformerNode::updateRampLUT(MDataBlock& data, probeDeformerGeom& G){
+    geomLock.lock();
+    if(!data.isClean(aRampLUT)){
+        MObject thisNode = thisMObject();
+        int resolution = data.inputValue( aRampResolution ).asInt();
+        MRampAttribute rWeightCurveR( thisNode, aWeightCurveR );
+        MRampAttribute rWeightCurveS( thisNode, aWeightCurveS );
+        MRampAttribute rWeightCurveL( thisNode, aWeightCurveL );
+        lutR.sample(rWeightCurveR, resolution);
+        lutS.sample(rWeightCurveS, resolution);
+        lutL.sample(rWeightCurveL, resolution);
+        data.setClean(aRampLUT);
+    }
+    G.lutR = lutR;
+    G.lutS = lutS;
+    G.lutL = lutL;
+    geomLock.unlock();
+}
+
+// normalised weights of the probes on an element at the given distances, for the non-harmonic weight modes
+void probeDeformerNode::closedFormWeight(const probeDeformerGeom& G, int channel, const std::vector<double>& dist, std::vector<double>& w) const{
+    const RampLUT& lut = channel == WC_SHEAR ? G.lutS : (channel == WC_TRANSLATION ? G.lutL : G.lutR);
+    for( int i=0; i<G.numPrb; i++){
+        if(G.weightMode == WM_INV_DISTANCE){
+            w[i] = G.probeRadius[i]/pow(dist[i],G.normExponent);
+        }else if(G.weightMode == WM_CUTOFF_DISTANCE){
+            w[i] = (dist[i] > G.probeRadius[i])
+            ? 0 : pow((G.probeRadius[i]-dist[i])/G.probeRadius[i],G.normExponent);
+        }else if(G.weightMode == WM_DRAW){
+            w[i] = lut(dist[i]/G.probeRadius[i]);
+        }
+    }
+    G.D.normaliseWeight(G.normaliseWeightMode, w);
+}
  
 MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const MMatrix &localToWorldMatrix, unsigned int mIndex ){
     
     MObject thisNode = thisMObject();
     MStatus status;
     MThreadUtils::syncNumOpenMPThreads();    // for OpenMP
+    probeDeformerGeom& G = getGeom(data, mIndex);
+    Laplacian& M = G.M;
+    BlendAff& B = G.B;
+    Distance& D = G.D;
+    std::vector<T>& constraint = G.constraint;
+    ProbeWeight& W = G.W;
+    int &numPrb = G.numPrb, &numPts = G.numPts;
+    PointBuffer& points = G.points;
+    std::vector<double>& ptsWeight = G.ptsWeight;
     bool worldMode = data.inputValue( aWorldMode ).asBool();
     bool areaWeighted = data.inputValue( aAreaWeighted ).asBool();
     short blendMode = data.inputValue( aBlendMode ).asShort();
@@ -76,18 +162,13 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
         deleteAttr(data, aInitMatrix, indices);
         deleteAttr(data, aProbeWeight, indices);
     }
-    // get positions
-    MPointArray Mpts;
-    itGeo.allPositions(Mpts);
-    int new_numPts = Mpts.length();
-    if(worldMode){
-        for(int j=0; j<new_numPts; j++ )
-            Mpts[j] *= localToWorldMatrix;
-    }
-    std::vector<Vector3d> pts(new_numPts);
-    for(int i=0;i<new_numPts;i++){
-        pts[i] << Mpts[i].x, Mpts[i].y, Mpts[i].z;
-    }
+    // get positions; in worldMode the whole pipeline works in world space,
+    // and the conversion is done only when reading and writing Maya's points.
+    // The points are read from Maya's buffer where they are used, and copied only for the weight computation
+    Matrix4d localToWorld = toMatrix4d(localToWorldMatrix);
+    Matrix4d worldToLocal = localToWorld.inverse();
+    points.read(data, outputGeom, mIndex, itGeo);
+    int new_numPts = points.numPts;
 
     //
     bool isNumProbeChanged = (numPrb != hMatrixArray.elementCount() || numPts != new_numPts);
@@ -95,7 +176,7 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
     numPts = new_numPts;
     B.setNum(numPrb);
 // setting transformation matrix
-    std::vector<Matrix4d> initMatrix(numPrb), matrix(numPrb);
+    std::vector<Matrix4d> &initMatrix = G.initMatrix, &matrix = G.matrix;
     readMatrixArray(hInitMatrixArray, initMatrix);
     readMatrixArray(hMatrixArray, matrix);
     for( int i=0;i<numPrb;i++){
@@ -106,15 +187,17 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
     
 // transform target vertices
     // load per vertex weights
-    std::vector<double> ptsWeight(numPts);
-    for (int i=0; !itGeo.isDone(); itGeo.next()){
-        ptsWeight[i++] = weightValue(data, mIndex, itGeo.index());
+    if(G.isPaintDirty || ptsWeight.size() != numPts){
+        G.isPaintUniform = readPaintedWeight(data, weightList, weights, mIndex, itGeo, ptsWeight);
+        G.isPaintDirty = false;
     }
     
     // weight computation
-    if(!data.isClean(aComputeWeight) || isNumProbeChanged){
+    if(G.isWeightDirty || isNumProbeChanged){
         // load probe weights
-        std::vector<double> probeWeight(numPrb), probeRadius(numPrb);
+        std::vector<double> probeWeight(numPrb);
+        std::vector<double>& probeRadius = G.probeRadius;
+        probeRadius.resize(numPrb);
         MArrayDataHandle handle = data.inputArrayValue(aProbeWeight);
         if(handle.elementCount() != numPrb){
             MGlobal::displayInfo("# of Probes and probeWeight are different");
@@ -126,42 +209,28 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
             probeRadius[i] = probeWeight[i] * effectRadius;
         }
         //
-        wr.resize(numPts),ws.resize(numPts),wl.resize(numPts);
-        for(int j=0; j<numPts; j++ ){
-            wr[j].resize(numPrb);ws[j].resize(numPrb);wl[j].resize(numPrb);
+        // a single weight field serves all channels unless the ramps differ
+        if(weightMode == WM_DRAW){
+            updateRampLUT(data, G);
         }
-        D.setNum(numPrb, numPts, 0);
-        D.computeDistPts(pts, B.centre);
-        D.findClosestPts();
-        if(weightMode == WM_INV_DISTANCE){
-            for(int j=0; j<numPts; j++ ){
-                for( int i=0; i<numPrb; i++){
-                    wr[j][i] = ws[j][i] = wl[j][i] = probeRadius[i]/pow(D.distPts[i][j],normExponent);
-                }
-            }
-        }else if(weightMode == WM_CUTOFF_DISTANCE){
-            for(int j=0; j<numPts; j++ ){
-                for( int i=0; i<numPrb; i++){
-                    wr[j][i] = ws[j][i] = wl[j][i] = (D.distPts[i][j] > probeRadius[i])
-                    ? 0 : pow((probeRadius[i]-D.distPts[i][j])/probeRadius[i],normExponent);
-                }
-            }
-        }else if(weightMode == WM_DRAW){
-            MRampAttribute rWeightCurveR( thisNode, aWeightCurveR, &status );
-            MRampAttribute rWeightCurveS( thisNode, aWeightCurveS, &status );
-            MRampAttribute rWeightCurveL( thisNode, aWeightCurveL, &status );
-            float val;
-            for(int j=0; j<numPts; j++ ){
-                for( int i=0; i<numPrb; i++){
-                    rWeightCurveR.getValueAtPosition(D.distPts[i][j]/probeRadius[i], val );
-                    wr[j][i] = val;
-                    rWeightCurveS.getValueAtPosition(D.distPts[i][j]/probeRadius[i], val );
-                    ws[j][i] = val;
-                    rWeightCurveL.getValueAtPosition(D.distPts[i][j]/probeRadius[i], val );
-                    wl[j][i] = val;
-                }
-            }
-        }else if(weightMode & WM_HARMONIC){
+        short normaliseWeightMode = data.inputValue( aNormaliseWeight ).asShort();
+        G.normExponent = normExponent;
+        G.weightMode = weightMode;
+        G.normaliseWeightMode = normaliseWeightMode;
+        // closed-form weights need not be stored
+        G.isStreaming = (data.inputValue( aWeightStorage ).asShort() == WS_RECOMPUTE) && !(weightMode & WM_HARMONIC);
+        short weightPrecision = data.inputValue( aWeightPrecision ).asShort();
+        W.setNum(G.isStreaming ? 0 : numPts, numPrb, weightMode != WM_DRAW || (G.lutR.table == G.lutS.table && G.lutR.table == G.lutL.table), weightPrecision);
+        D.setNum(numPrb, G.isStreaming ? 0 : numPts, 0, weightPrecision != WP_DOUBLE);
+        std::vector<Vector3d> pts(G.isStreaming ? 0 : numPts);
+        for(int i=0;i<(int)pts.size();i++){
+            pts[i] = worldMode ? points.get(i, localToWorld) : points.get(i);
+        }
+        if(!G.isStreaming){
+            D.computeDistPts(pts, B.centre);
+            D.findClosestPts(pts, B.centre);
+        }
+        if(weightMode & WM_HARMONIC){
             makeFaceTet(data, input, inputGeom, mIndex, pts, M.tetList, M.tetMatrix, M.tetWeight);
             M.numTet = (int)M.tetList.size()/4;
             constraint.resize(numPrb);
@@ -173,7 +242,7 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
             if( data.inputValue( aNeighbourWeighting ).asBool() ){
                 for(int i=0;i<numPrb;i++){
                     for(int j=0;j<numPts;j++){
-                        if(D.distPts[i][j]<effectRadius){
+                        if(D.distPts(i,j)<effectRadius){
                             constraint.push_back(T(i,j,probeWeight[i]));
                         }
                     }
@@ -195,6 +264,7 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
             }
             // solve the laplace equation
             int isError;
+            M.setSolver(data.inputValue( aSolver ).asShort());
             if( weightMode == WM_HARMONIC_ARAP){
                 M.computeTetMatrixInverse();
                 M.dim = numPts + M.numTet;
@@ -204,23 +274,34 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
                 isError = M.cotanPrecompute();
             }
             if(isError>0) return MS::kFailure;
-            M.harmonicSolve();
-            for(int i=0;i<numPrb;i++){
-                for(int j=0;j<numPts;j++){
-                    wr[j][i] = ws[j][i] = wl[j][i] = M.Sol.coeff(j,i);
+            data.outputValue( aFactorisationTime ).set( M.solver->factorTime );
+            data.outputValue( aFactorisationMemory ).set( M.solver->factorBytes / 1048576.0 );
+            data.setClean( aFactorisationTime );
+            data.setClean( aFactorisationMemory );
+            // harmonic weights are streamed into the weight table and normalised there row by row
+            W.startRows();
+            HarmonicStore store(W);
+            M.harmonicSolve(store);
+            W.finishRows(RowNormaliser(D, normaliseWeightMode));
+        }else if(!G.isStreaming){
+            // compute, normalise and store weights row by row
+#pragma omp parallel for
+            for(int j=0; j<numPts; j++ ){
+                std::vector<double> dist(numPrb), w(numPrb);
+                for( int i=0; i<numPrb; i++){
+                    dist[i] = D.distPts(i,j);
+                }
+                for(int c=0;c<W.numChannel;c++){
+                    closedFormWeight(G, c, dist, w);
+                    W.setRow(c, j, w);
                 }
             }
         }
-        // normalise weights
-        short normaliseWeightMode = data.inputValue( aNormaliseWeight ).asShort();
-        for(int j=0;j<numPts;j++){
-            D.normaliseWeight(normaliseWeightMode, wr[j]);
-            D.normaliseWeight(normaliseWeightMode, ws[j]);
-            D.normaliseWeight(normaliseWeightMode, wl[j]);
-        }
         
         // END of weight computation
-        status = data.setClean(aComputeWeight);
+        G.isWeightDirty = false;
+        data.outputValue( aWeightMemory ).set( (W.bytes() + D.distPts.bytes() + D.distTet.bytes()) / 1048576.0 );
+        data.setClean( aWeightMemory );
     }
     
     // compute the blended transformations at each mesh point
@@ -251,79 +332,90 @@ MStatus probeDeformerNode::deform( MDataBlock& data, MItGeometry& itGeo, const M
                 M.Sol(j,5), M.Sol(j,7), M.Sol(j,8);
             l << M.Sol(j,9), M.Sol(j,10), M.Sol(j,11);
             mat = pad(expSym(SS)*expSO(RR), l);
-            RowVector4d p = pad(pts[j]) * mat;
-            Mpts[j].x = p[0];
-            Mpts[j].y = p[1];
-            Mpts[j].z = p[2];
+            RowVector4d p = pad(worldMode ? points.get(j, localToWorld) : points.get(j)) * mat;
             if(worldMode)
-                Mpts[j] *= localToWorldMatrix.inverse();
+                p = p * worldToLocal;
+            points.set(j, p);
         }
     }else{
-#pragma omp parallel for
+        // points are processed in tiles; in the streaming mode each tile goes through
+        // distance, weight, blend and transform without touching any table
+        G.scratch.resize(4, numPrb);
+#pragma omp parallel for schedule(dynamic, STREAM_TILE_SIZE)
         for(int j=0; j<numPts; j++ ){
-            std::vector<double> wrr(numPrb),wss(numPrb),wll(numPrb);
-            for(int i=0;i<numPrb;i++){
-                wrr[i]=ptsWeight[j]*wr[j][i];
-                wss[i]=ptsWeight[j]*ws[j][i];
-                wll[i]=ptsWeight[j]*wl[j][i];
+            Vector3d q = worldMode ? points.get(j, localToWorld) : points.get(j);
+            if(G.isStreaming){
+                std::vector<double>& dist = G.scratch.get(3);
+                for(int i=0;i<numPrb;i++){
+                    dist[i] = (q-B.centre[i]).norm();
+                }
+                closedFormWeight(G, WC_ROTATION, dist, G.scratch.get(0));
+                if(!W.isShared()){
+                    closedFormWeight(G, WC_SHEAR, dist, G.scratch.get(1));
+                    closedFormWeight(G, WC_TRANSLATION, dist, G.scratch.get(2));
+                }
+            }else{
+                W.row(WC_ROTATION, j, G.scratch.get(0));
+                if(!W.isShared()){
+                    W.row(WC_SHEAR, j, G.scratch.get(1));
+                    W.row(WC_TRANSLATION, j, G.scratch.get(2));
+                }
             }
-            // blend matrix
-            Matrix4d mat;
-            if(blendMode == BM_SRL){
-                Matrix3d RR,SS;
-                Vector3d l=blendMat(B.L, wll);
-                SS = expSym(blendMat(B.logS, wss));
-                RR = frechetSum ? frechetSO(B.R, wrr) : expSO(blendMat(B.logR, wr[j]));
-                mat = pad(SS*RR, l);
-            }else if(blendMode == BM_SSE){
-                Matrix4d RR;
-                Matrix3d SS=expSym(blendMat(B.logS, wss));
-                RR = expSE(blendMat(B.logSE, wrr));
-                mat = pad(SS,Vector3d::Zero()) * RR;
-            }else if(blendMode == BM_LOG3){
-                Matrix3d RR=blendMat(B.logGL, wrr).exp();
-                Vector3d l=blendMat(B.L, wll);
-                mat = pad(RR, l);
-            }else if(blendMode == BM_LOG4){
-                mat=blendMat(B.logAff, wrr).exp();
-            }else if(blendMode == BM_SQL){
-                Vector4d q=blendQuat(B.quat,wrr);
-                Vector3d l=blendMat(B.L, wll);
-                Matrix3d SS=blendMatLin(B.S,wss);
-                Quaternion<double> Q(q);
-                Matrix3d RR = Q.matrix().transpose();
-                mat = pad(SS*RR, l);
-            }else if(blendMode == BM_AFF){
-                mat = blendMatLin(B.Aff,wrr);
+            std::vector<double> &wrr = G.scratch.get(0);
+            std::vector<double> &wss = W.isShared() ? wrr : G.scratch.get(1);
+            std::vector<double> &wll = W.isShared() ? wrr : G.scratch.get(2);
+            // painted weights are multiplied only when they are not all 1.0
+            if(!G.isPaintUniform){
+                for(int i=0;i<numPrb;i++){
+                    wrr[i] *= ptsWeight[j];
+                    if(!W.isShared()){
+                        wss[i] *= ptsWeight[j];
+                        wll[i] *= ptsWeight[j];
+                    }
+                }
             }
+            // blend matrix
+            Matrix3d SS,RR;
+            Matrix4d mat = B.blend(blendMode, frechetSum, wrr, wss, wll, SS, RR);
             // apply matrix
-            RowVector4d p = pad(pts[j]) * mat;
-            Mpts[j].x = p[0];
-            Mpts[j].y = p[1];
-            Mpts[j].z = p[2];
+            RowVector4d p = pad(q) * mat;
             if(worldMode)
-                Mpts[j] *= localToWorldMatrix.inverse();
+                p = p * worldToLocal;
+            points.set(j, p);
         }
     }
     
-    // set positions
-    itGeo.setAllPositions(Mpts);
+    // set vertex colour; it is computed before the positions are written, as it reads the input points
+    std::vector<double> ptsColour;
+    if(visualisationMode == VM_STIFFNESS){
+        ptsColour.resize(numPts);
+        for(int i=0;i<numPts;i++){
+            ptsColour[i] = 1.0 - ptsWeight[i];
+        }
+    }else if(visualisationMode == VM_EFFECT){
+        ptsColour.resize(numPts);
+        std::vector<double> dist(numPrb), w(numPrb);
+        for(int j=0;j<numPts;j++){
+//            ptsColour[j] = std::accumulate(wr[j].begin(), wr[j].end(), 0.0);
+            if(G.isStreaming){
+                Vector3d q = worldMode ? points.get(j, localToWorld) : points.get(j);
+                for(int i=0;i<numPrb;i++){
+                    dist[i] = (q-B.centre[i]).norm();
+                }
+                closedFormWeight(G, WC_ROTATION, dist, w);
+                ptsColour[j] = visualisationMultiplier * w[numPrb-1];
+            }else{
+                ptsColour[j] = visualisationMultiplier * W(WC_ROTATION,j,numPrb-1);
+            }
+        }
+    }
     
+    // set positions
+    points.write(itGeo);
     
-    // set vertex colour
     if(visualisationMode != VM_OFF){
-        std::vector<double> ptsColour(numPts, 0.0);
-        if(visualisationMode == VM_STIFFNESS){
-            for(int i=0;i<numPts;i++){
-                ptsColour[i] = 1.0 - ptsWeight[i];
-            }
-        }else if(visualisationMode == VM_EFFECT){
-            for(int j=0;j<numPts;j++){
-//                ptsColour[j] = std::accumulate(wr[j].begin(), wr[j].end(), 0.0);
-                ptsColour[j] = visualisationMultiplier * wr[j][numPrb-1];
-            }
-        }
-        visualise(data, outputGeom, ptsColour);
+        ptsColour.resize(numPts, 0.0);
+        visualise(data, outputGeom, mIndex, ptsColour);
     }
 
     return MS::kSuccess;
@@ -345,6 +437,21 @@ MStatus probeDeformerNode::initialize()
     nAttr.setKeyable(false);
     addAttribute( aComputeWeight );
 
+    // this attr will be dirtied when painted weights are changed
+    aPaintedWeight = nAttr.create( "paintedWeight", "paintedWeight", MFnNumericData::kBoolean, true );
+    nAttr.setHidden(true);
+    nAttr.setStorable(false);
+    nAttr.setKeyable(false);
+    addAttribute( aPaintedWeight );
+    attributeAffects( weightList, aPaintedWeight );
+
+    // this attr will be dirtied when the ramp curves are changed
+    aRampLUT = nAttr.create( "rampLUT", "rampLUT", MFnNumericData::kBoolean, true );
+    nAttr.setHidden(true);
+    nAttr.setStorable(false);
+    nAttr.setKeyable(false);
+    addAttribute( aRampLUT );
+
     aMatrix = mAttr.create("probeMatrix", "pm");
     mAttr.setStorable(false);
     mAttr.setHidden(true);
@@ -404,6 +511,28 @@ MStatus probeDeformerNode::initialize()
     attributeAffects( aNormaliseWeight, outputGeom );
     attributeAffects( aNormaliseWeight, aComputeWeight );
 
+    aWeightPrecision = eAttr.create( "weightPrecision", "wp", WP_DOUBLE );
+    eAttr.addField( "double", WP_DOUBLE );
+    eAttr.addField( "float", WP_FLOAT );
+    eAttr.addField( "fixed16", WP_FIXED16 );
+    eAttr.setStorable(true);
+    addAttribute( aWeightPrecision );
+    attributeAffects( aWeightPrecision, outputGeom );
+    attributeAffects( aWeightPrecision, aComputeWeight );
+    // memory (MB) of the weight and distance tables
+    aWeightMemory = nAttr.create("weightMemory", "wmm", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aWeightMemory );
+
+    aWeightStorage = eAttr.create( "weightStorage", "ws", WS_STORE );
+    eAttr.addField( "store", WS_STORE );
+    eAttr.addField( "recompute", WS_RECOMPUTE );
+    eAttr.setStorable(true);
+    addAttribute( aWeightStorage );
+    attributeAffects( aWeightStorage, outputGeom );
+    attributeAffects( aWeightStorage, aComputeWeight );
+
     aWeightMode = eAttr.create( "weightMode", "wtm", WM_INV_DISTANCE );
     eAttr.addField( "inverse", WM_INV_DISTANCE );
     eAttr.addField( "cutoff", WM_CUTOFF_DISTANCE );
@@ -416,6 +545,30 @@ MStatus probeDeformerNode::initialize()
     attributeAffects( aWeightMode, outputGeom );
     attributeAffects( aWeightMode, aComputeWeight );
 
+    aSolver = eAttr.create( "solver", "slv", SOLVER_LDLT );
+    eAttr.addField( "SimplicialLDLT", SOLVER_LDLT );
+    eAttr.addField( "SimplicialLLT", SOLVER_LLT );
+    eAttr.addField( "SparseLU", SOLVER_LU );
+    eAttr.addField( "CHOLMOD", SOLVER_CHOLMOD );
+    eAttr.addField( "CG", SOLVER_CG );
+    eAttr.addField( "multigrid", SOLVER_MG );
+    eAttr.addField( "CG multigrid", SOLVER_CG_MG );
+    eAttr.addField( "CG Schwarz", SOLVER_SCHWARZ );
+    eAttr.setStorable(true);
+    addAttribute( aSolver );
+    attributeAffects( aSolver, outputGeom );
+    attributeAffects( aSolver, aComputeWeight );
+
+    // time (sec) and memory (MB) of the last factorisation
+    aFactorisationTime = nAttr.create("factorisationTime", "fct", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aFactorisationTime );
+    aFactorisationMemory = nAttr.create("factorisationMemory", "fcm", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aFactorisationMemory );
+
     aAreaWeighted = nAttr.create( "areaWeighted", "aw", MFnNumericData::kBoolean, false );
     nAttr.setStorable(true);
     addAttribute( aAreaWeighted );
@@ -461,14 +614,35 @@ MStatus probeDeformerNode::initialize()
     addAttribute( aWeightCurveR );
 	attributeAffects( aWeightCurveR, outputGeom );
 	attributeAffects( aWeightCurveR, aComputeWeight );
+	attributeAffects( aWeightCurveR, aRampLUT );
     aWeightCurveS = rAttr.createCurveRamp( "weightCurveShear", "wcs" );
     addAttribute( aWeightCurveS );
 	attributeAffects( aWeightCurveS, outputGeom );
 	attributeAffects( aWeightCurveS, aComputeWeight );
+	attributeAffects( aWeightCurveS, aRampLUT );
     aWeightCurveL = rAttr.createCurveRamp( "weightCurveTranslation", "wcl" );
     addAttribute( aWeightCurveL );
 	attributeAffects( aWeightCurveL, outputGeom );
 	attributeAffects( aWeightCurveL, aComputeWeight );
+	attributeAffects( aWeightCurveL, aRampLUT );
+
+    aRampResolution = nAttr.create("rampResolution", "rres", MFnNumericData::kInt, 256);
+    nAttr.setMin( 2 );
+    nAttr.setStorable(true);
+	addAttribute( aRampResolution );
+	attributeAffects( aRampResolution, outputGeom );
+	attributeAffects( aRampResolution, aComputeWeight );
+	attributeAffects( aRampResolution, aRampLUT );
+
+    // the statistics are written by deform() when the weights are computed; they are dirtied
+    // by the inputs they report on and hold the values of the last deformation
+    attributeAffects( aComputeWeight, aWeightMemory );
+    attributeAffects( aWeightPrecision, aWeightMemory );
+    attributeAffects( aWeightStorage, aWeightMemory );
+    attributeAffects( aComputeWeight, aFactorisationTime );
+    attributeAffects( aComputeWeight, aFactorisationMemory );
+    attributeAffects( aSolver, aFactorisationTime );
+    attributeAffects( aSolver, aFactorisationMemory );
 
     return MS::kSuccess;
 }
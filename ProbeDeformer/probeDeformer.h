@@ -15,17 +15,44 @@
 #include "../deformerConst.h"
 #include "../blendAff.h"
 #include "../distance.h"
+#include "../probeWeight.h"
 
 using namespace Eigen;
 
 typedef SparseMatrix<double> SpMat;
 typedef Triplet<double> T;
 
+// cached data for each deformed geometry (indexed by mIndex)
+class probeDeformerGeom
+{
+public:
+    probeDeformerGeom(): numPrb(0), numPts(0), isWeightDirty(true), isPaintDirty(true), isPaintUniform(true), isStreaming(false) {};
+    Laplacian M;
+    BlendAff B;
+    Distance D;
+    std::vector<T> constraint;
+    ProbeWeight W;
+    int numPrb, numPts;
+    bool isWeightDirty;   // weights of this geometry have to be recomputed
+    bool isPaintDirty;    // painted weights have to be reloaded
+    bool isPaintUniform;  // all the painted weights are 1.0
+    bool isStreaming;     // closed-form weights are recomputed in the blend loop instead of stored
+    // parameters of the closed-form weights
+    std::vector<double> probeRadius;
+    double normExponent;
+    short weightMode, normaliseWeightMode;
+    RampLUT lutR, lutS, lutL;   // copies of the sampled weight curves, read without the lock
+    // per frame buffers kept to avoid reallocation
+    PointBuffer points;
+    std::vector<Matrix4d> initMatrix, matrix;
+    std::vector<double> ptsWeight;
+    BlendScratch scratch;
+};
 
 class probeDeformerNode : public MPxDeformerNode
 {
 public:
-    probeDeformerNode(): numPrb(0), numPts(0) {};
+    probeDeformerNode() {};
     virtual MStatus deform( MDataBlock& data, MItGeometry& itGeo, const MMatrix &localToWorldMatrix, unsigned int mIndex );
 	virtual MStatus accessoryNodeSetup( MDagModifier& cmd );
     static  void*   creator();
@@ -44,21 +71,30 @@ public:
 	static MObject		aWeightCurveL;
 	static MObject		aEffectRadius;
     static MObject      aNormaliseWeight;
+    static MObject      aWeightPrecision;
+    static MObject      aWeightMemory;
+    static MObject      aWeightStorage;
 	static MObject		aRotationConsistency;
 	static MObject		aFrechetSum;
     static MObject      aNormExponent;
     static MObject      aVisualisationMode;
     static MObject      aProbeWeight;
     static MObject      aComputeWeight;
+    static MObject      aPaintedWeight;   // this attr will be dirtied when painted weights are changed
+    static MObject      aRampLUT;   // this attr will be dirtied when the ramp curves are changed
+    static MObject      aRampResolution;
     static MObject      aVisualisationMultiplier;
     static MObject      aAreaWeighted;
     static MObject      aNeighbourWeighting;
+    static MObject      aSolver;
+    static MObject      aFactorisationTime;
+    static MObject      aFactorisationMemory;
     
 private:
-    Laplacian M;
-    BlendAff B;
-    Distance D;
-    std::vector<T> constraint;
-    std::vector< std::vector<double> > wr,ws,wl;
-    int numPrb, numPts;
+    probeDeformerGeom& getGeom(MDataBlock& data, unsigned int mIndex);
+    void updateRampLUT(MDataBlock& data, probeDeformerGeom& G);
+    void closedFormWeight(const probeDeformerGeom& G, int channel, const std::vector<double>& dist, std::vector<double>& w) const;
+    RampLUT lutR, lutS, lutL;   // sampled weight curves, guarded by geomLock
+    std::map<unsigned int, probeDeformerGeom> geom;   // cache for each input geometry
+    MMutexLock geomLock;   // guards geom and the dirty flags
 };
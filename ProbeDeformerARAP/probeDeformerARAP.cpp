@@ -45,17 +45,116 @@ MObject probeDeformerARAPNode::aStiffness;
 MObject probeDeformerARAPNode::aProbeWeight;
 MObject probeDeformerARAPNode::aProbeConstraintRadius;
 MObject probeDeformerARAPNode::aComputeWeight;
+MObject probeDeformerARAPNode::aPaintedWeight;
+MObject probeDeformerARAPNode::aRampLUT;
+MObject probeDeformerARAPNode::aRampResolution;
 MObject probeDeformerARAPNode::aNormaliseWeight;
+MObject probeDeformerARAPNode::aWeightPrecision;
+MObject probeDeformerARAPNode::aWeightMemory;
 MObject probeDeformerARAPNode::aAreaWeighted;
 MObject probeDeformerARAPNode::aNeighbourWeighting;
+MObject probeDeformerARAPNode::aCacheStages;
+MObject probeDeformerARAPNode::aSolver;
+MObject probeDeformerARAPNode::aFillOrdering;
+MObject probeDeformerARAPNode::aMixedPrecision;
+MObject probeDeformerARAPNode::aMatrixFree;
+MObject probeDeformerARAPNode::aVertexOrdering;
+MObject probeDeformerARAPNode::aFactorisationTime;
+MObject probeDeformerARAPNode::aFactorisationMemory;
+MObject probeDeformerARAPNode::aSolveResidual;
+MObject probeDeformerARAPNode::aReduced;
+MObject probeDeformerARAPNode::aReducedModes;
+MObject probeDeformerARAPNode::aReducedSamples;
+MObject probeDeformerARAPNode::aReducedErrorCheck;
+MObject probeDeformerARAPNode::aReducedError;
+
+// stores the solutions of the harmonic weighting on the tets into the weight table
+struct HarmonicStore {
+    short tetMode;
+    const std::vector<int>& tetList;
+    const MeshTopology& topo;
+    ProbeWeight& W;
+    HarmonicStore(short _tetMode, const std::vector<int>& _tetList, const MeshTopology& _topo, ProbeWeight& _W):
+        tetMode(_tetMode), tetList(_tetList), topo(_topo), W(_W) {};
+    void operator()(int first, const MatrixXd& X){
+        std::vector<double> w_tet;
+        for(int c=0;c<X.cols();c++){
+            makeTetWeightList(tetMode, tetList, topo, X.col(c), w_tet);
+            for(int j=0;j<W.numElem;j++){
+                W.set(WC_ROTATION, j, first+c, w_tet[j]);
+            }
+        }
+    }
+};
 
 void* probeDeformerARAPNode::creator() { return new probeDeformerARAPNode; }
+
+// get the cache for the mIndex-th geometry
+probeDeformerARAPGeom& probeDeformerARAPNode::getGeom(MDataBlock& data, unsigned int mIndex){
+    geomLock.lock();
+    probeDeformerARAPGeom& G = geom[mIndex];
+    // dirtiness of the node is handed over to every geometry
+    bool isARAPDirty = !data.isClean(aARAP);
+    bool isWeightDirty = !data.isClean(aComputeWeight);
+    bool isPaintDirty = !data.isClean(aPaintedWeight);
+    std::map<unsigned int, probeDeformerARAPGeom>::iterator iter;
+    for(iter = geom.begin(); iter != geom.end(); iter++){
+        // the rest pose and the probe distances are reread, and the stages after them are rerun
+        if(isARAPDirty){
+            iter->second.cache.invalidate(ST_REST);
+            iter->second.isTopologyDirty = true;
+        }
+        if(isWeightDirty) iter->second.cache.invalidate(ST_DISTANCE);
+        iter->second.isPaintDirty |= isPaintDirty;
+    }
+    if(isARAPDirty) data.setClean(aARAP);
+    if(isWeightDirty) data.setClean(aComputeWeight);
+    if(isPaintDirty) data.setClean(aPaintedWeight);
+    geomLock.unlock();
+    return G;
+}
+
+// sample the ramp curves into lookup tables when they are changed, and hand a copy to the geometry,
+// which reads it without the lock while other geometries may resample
+void probeDeformerARAPNode::updateRampLUT(MDataBlock& data, probeDeformerARAPGeom& G){
+    geomLock.lock();
+    if(!data.isClean(aRampLUT)){
+        MObject thisNode = thisMObject();
+        int resolution = data.inputValue( aRampResolution ).asInt();
+        MRampAttribute rWeightCurveR( thisNode, aWeightCurveR );
+        MRampAttribute rWeightCurveS( thisNode, aWeightCurveS );
+        MRampAttribute rWeightCurveL( thisNode, aWeightCurveL );
+        lutR.sample(rWeightCurveR, resolution);
+        lutS.sample(rWeightCurveS, resolution);
+        lutL.sample(rWeightCurveL, resolution);
+        data.setClean(aRampLUT);
+    }
+    G.lutR = lutR;
+    G.lutS = lutS;
+    G.lutL = lutL;
+    geomLock.unlock();
+}
  
 MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, const MMatrix &localToWorldMatrix, unsigned int mIndex )
 {
 	MObject thisNode = thisMObject();
     MStatus status;
     MThreadUtils::syncNumOpenMPThreads();    // for OpenMP
+    probeDeformerARAPGeom& G = getGeom(data, mIndex);
+    BlendAff& B = G.B;
+    Distance& D = G.D;
+    Laplacian& mesh = G.mesh;
+    std::vector<Vector3d> &tetCenter = G.tetCenter, &pts = G.pts, &new_pts = G.new_pts;
+    MeshTopology& topo = G.topo;
+    ProbeWeight& W = G.W;
+    short& isError = G.isError;
+    int& numPrb = G.numPrb;
+    std::vector<T>& constraint = G.constraint;
+    std::vector<Matrix4d> &A = G.A, &Q = G.Q;
+    std::vector<Matrix3d> &blendedR = G.blendedR, &blendedS = G.blendedS;
+    std::vector<Vector4d>& blendedL = G.blendedL;
+    std::vector<double>& tetEnergy = G.tetEnergy;
+    PointBuffer& points = G.points;
     
     bool worldMode = data.inputValue( aWorldMode ).asBool();
     bool areaWeighted = data.inputValue( aAreaWeighted ).asBool();
@@ -88,62 +187,121 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
         deleteAttr(data, aProbeConstraintRadius, indices);
         deleteAttr(data, aProbeWeight, indices);
     }
-    bool isNumProbeChanged = (numPrb != hMatrixArray.elementCount());
     numPrb = hMatrixArray.elementCount();
     B.setNum(numPrb);
     // read matrices from probes
-    std::vector<Matrix4d> initMatrix(numPrb), matrix(numPrb);
+    std::vector<Matrix4d> &initMatrix = G.initMatrix, &matrix = G.matrix;
     readMatrixArray(hInitMatrixArray, initMatrix);
     readMatrixArray(hMatrixArray, matrix);
     // read vertex positions
-    MPointArray Mpts;
-    itGeo.allPositions(Mpts);
-    int numPts = Mpts.length();
-    
-    // compute distance
-    if(!data.isClean(aARAP) || !data.isClean(aComputeWeight) || isNumProbeChanged){
-        // load points list
-        if(worldMode){
-            for(int j=0; j<numPts; j++ )
-                Mpts[j] *= localToWorldMatrix;
+    points.read(data, outputGeom, mIndex, itGeo);
+    int numPts = points.numPts;
+    
+    // the precomputation is split into cached stages. A stage is rerun only when
+    // the attributes it reads (its key) change, when it is invalidated by a dirtied array or mesh input,
+    // or when a stage it depends on has been rerun.
+    CacheGraph& cache = G.cache;
+    cache.clearLog();
+    short weightPrecision = data.inputValue( aWeightPrecision ).asShort();
+    short solverType = data.inputValue( aSolver ).asShort();
+    short fillOrdering = data.inputValue( aFillOrdering ).asShort();
+    bool isMixed = data.inputValue( aMixedPrecision ).asBool();
+    bool matrixFree = data.inputValue( aMatrixFree ).asBool();
+    short vertexOrdering = data.inputValue( aVertexOrdering ).asShort();
+    std::vector<int>& newIndex = G.newIndex;
+    
+    // topology of the input mesh, keyed by the counts of its elements. The connectivity is hashed
+    // only when the counts change or a rebuild is requested, and extracted only when the hash differs
+    MObject oInputGeom;
+    status = getInputMesh(data, input, inputGeom, mIndex, oInputGeom);
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    MFnMesh inputMesh(oInputGeom);
+    if(cache.needs(ST_TOPOLOGY, (CacheKey() << inputMesh.numVertices() << inputMesh.numPolygons()
+                                 << inputMesh.numFaceVertices()).value) || G.isTopologyDirty){
+        unsigned long long hash = connectivityHash(oInputGeom);
+        if(hash != G.topologyHash){
+            getMeshTopology(oInputGeom, G.meshTopo);
+            G.topologyHash = hash;
+            cache.done(ST_TOPOLOGY);
+        }else{
+            cache.keep(ST_TOPOLOGY);
+        }
+        G.isTopologyDirty = false;
+    }
+    
+    // rest pose geometry; vertices and tets are reordered for locality,
+    // and every per-element array is kept in the new order up to the Maya boundary
+    if(cache.needs(ST_REST, (CacheKey() << tetMode << worldMode << vertexOrdering).value)){
+        // load points list; in worldMode the whole pipeline works in world space.
+        // Maya's order is held in new_pts, the buffer of the deformed points, until it is reordered
+        Matrix4d localToWorld = toMatrix4d(localToWorldMatrix);
+        new_pts.resize(numPts);
+        for(int i=0;i<numPts;i++){
+            new_pts[i] = worldMode ? points.get(i, localToWorld) : points.get(i);
         }
+        makeVertexOrdering(vertexOrdering, new_pts, G.meshTopo, newIndex);
         pts.resize(numPts);
         for(int i=0;i<numPts;i++){
-            pts[i] << Mpts[i].x, Mpts[i].y, Mpts[i].z;
+            pts[newIndex[i]] = new_pts[i];
         }
-        // make tetrahedral structure
-        getMeshData(data, input, inputGeom, mIndex, tetMode, pts, mesh.tetList, faceList, edgeList, vertexList, mesh.tetMatrix, mesh.tetWeight);
-        mesh.dim = removeDegenerate(tetMode, numPts, mesh.tetList, faceList, edgeList, vertexList, mesh.tetMatrix);
-        makeTetMatrix(tetMode, pts, mesh.tetList, faceList, edgeList, vertexList, mesh.tetMatrix, mesh.tetWeight);
+        // make tetrahedral structure; degenerate tets, which depend on the geometry,
+        // are removed from a copy of the topology
+        topo = G.meshTopo;
+        permuteTopology(newIndex, topo);
+        G.faceList = topo.faceList;
+        makeTetList(tetMode, numPts, topo, mesh.tetList);
+        makeTetMatrix(tetMode, pts, mesh.tetList, topo, mesh.tetMatrix, mesh.tetWeight);
+        mesh.dim = removeDegenerate(tetMode, numPts, mesh.tetList, topo, mesh.tetMatrix, mesh.tetWeight);
+        G.restTetWeight = mesh.tetWeight;
         makeTetCenterList(tetMode, pts, mesh.tetList, tetCenter);
         mesh.numTet = (int)mesh.tetList.size()/4;
         mesh.computeTetMatrixInverse();
+        cache.done(ST_REST);
+    }
+    
+    // distance between probes and tetrahedra, keyed also by the initial probe matrices
+    CacheKey distanceKey;
+    distanceKey << numPrb << (weightPrecision != WP_DOUBLE);
+    for(int i=0;i<numPrb;i++){
+        for(int k=0;k<16;k++){
+            distanceKey << initMatrix[i](k);
+        }
+    }
+    if(cache.needs(ST_DISTANCE, distanceKey.value)){
         // initial probe position
         for(int i=0;i<numPrb;i++){
             B.centre[i] = transPart(initMatrix[i]);
         }
-        // compute distance between probe and tetrahedra
-        D.setNum(numPrb, numPts, mesh.numTet);
+        D.setNum(numPrb, numPts, mesh.numTet, weightPrecision != WP_DOUBLE);
         D.computeDistTet(tetCenter, B.centre);
-        D.findClosestTet();
+        D.findClosestTet(tetCenter, B.centre);
         D.computeDistPts(pts, B.centre);
-        D.findClosestPts();
-        if(!areaWeighted){
-            mesh.tetWeight.clear();
-            mesh.tetWeight.resize(mesh.numTet,1.0);
-        }
+        D.findClosestPts(pts, B.centre);
+        cache.done(ST_DISTANCE);
+    }
+    
+    // painted stiffness is reloaded only when it is changed
+    if(stiffnessMode == SM_PAINT && (G.isPaintDirty || G.ptsWeight.size() != numPts)){
+        readPaintedWeight(data, weightList, weights, mIndex, itGeo, G.ptsWeight);
+        G.isPaintDirty = false;
+        cache.invalidate(ST_STIFFNESS);
     }
     
-    // (re)compute ARAP
-    if(!data.isClean(aARAP) || isNumProbeChanged){
+    // stiffness of tets
+    if(cache.needs(ST_STIFFNESS, (CacheKey() << stiffnessMode << areaWeighted).value)){
+        if(areaWeighted){
+            mesh.tetWeight = G.restTetWeight;
+        }else{
+            mesh.tetWeight.assign(mesh.numTet, 1.0);
+        }
         // load painted weights
         if(stiffnessMode == SM_PAINT) {
             VectorXd ptsWeight(numPts);
-            for (int i=0; !itGeo.isDone(); itGeo.next()){
-                double w=weightValue(data, mIndex, itGeo.index());
-                ptsWeight[i++] = (w>EPSILON) ? w : EPSILON;
+            for(int i=0;i<numPts;i++){
+                ptsWeight[newIndex[i]] = std::max(G.ptsWeight[i], EPSILON);
             }
-            makeTetWeightList(tetMode, mesh.tetList, faceList, edgeList, vertexList, ptsWeight, mesh.tetWeight);
+            // the painted stiffness replaces the area weights
+            makeTetWeightList(tetMode, mesh.tetList, topo, ptsWeight, mesh.tetWeight);
         }else if(stiffnessMode == SM_LEARN) {
             std::vector<double> tetEnergy(mesh.numTet,0);
             MArrayDataHandle hSupervisedMesh = data.inputArrayValue(aSupervisedMesh);
@@ -159,10 +317,10 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
                 }
                 std::vector<Vector3d> spts(numPts);
                 for(int i=0;i<numPts;i++){
-                    spts[i] << Mspts[i].x, Mspts[i].y, Mspts[i].z;
+                    spts[newIndex[i]] << Mspts[i].x, Mspts[i].y, Mspts[i].z;
                 }
                 std::vector<double> dummy_weight;
-                makeTetMatrix(tetMode, spts, mesh.tetList, faceList, edgeList, vertexList, Q, dummy_weight);
+                makeTetMatrix(tetMode, spts, mesh.tetList, topo, Q, dummy_weight);
                 Matrix3d S,R;
                 for(int i=0;i<mesh.numTet;i++)  {
                     polarHigham((mesh.tetMatrixInverse[i]*Q[i]).block(0,0,3,3), S, R);
@@ -176,7 +334,12 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
                 mesh.tetWeight[i] *= w*w;
             }
         }
+        cache.done(ST_STIFFNESS);
+    }
 
+    // constraints of probes
+    double constraintRadius = data.inputValue( aConstraintRadius ).asDouble();
+    if(cache.needs(ST_CONSTRAINT, (CacheKey() << constraintMode << constraintWeight << constraintRadius << normExponent).value)){
         // find constraint points
         constraint.resize(3*numPrb);
         for(int i=0;i<numPrb;i++){
@@ -195,12 +358,11 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
                 handle.jumpToArrayElement(i);
                 probeConstraintRadius[i]=handle.inputValue().asDouble();
             }
-            double constraintRadius = data.inputValue( aConstraintRadius ).asDouble();
             for(int i=0;i<numPrb;i++){
                 double r = constraintRadius * probeConstraintRadius[i];
                 for(int j=0;j<numPts;j++){
-                    if(D.distPts[i][j]<r){
-                        constraint.push_back(T(i,j,constraintWeight * pow((r-D.distPts[i][j])/r,normExponent)));
+                    if(D.distPts(i,j)<r){
+                        constraint.push_back(T(i,j,constraintWeight * pow((r-D.distPts(i,j))/r,normExponent)));
                     }
                 }
             }
@@ -211,17 +373,30 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
         for(int cur=0;cur<numConstraint;cur++){
             mesh.constraintWeight[cur] = std::make_pair(constraint[cur].col(), constraint[cur].value());
         }
-        //
-        isError = mesh.ARAPprecompute();
-        status = data.setClean(aARAP);
-    }        // END of ARAP precomputation
+        cache.done(ST_CONSTRAINT);
+    }
     
-    if(isError>0){
-        return MS::kFailure;
+    // ARAP precomputation
+    if(cache.needs(ST_FACTORISATION, (CacheKey() << mesh.transWeight << solverType << fillOrdering << isMixed << matrixFree).value)){
+        mesh.setSolver(solverType, fillOrdering, isMixed, matrixFree);
+        isError = mesh.ARAPprecompute();
+        if(isError>0){
+            return MS::kFailure;
+        }
+        cache.done(ST_FACTORISATION);
     }
+    data.outputValue( aFactorisationTime ).set( mesh.solver->factorTime );
+    data.outputValue( aFactorisationMemory ).set( mesh.solver->factorBytes / 1048576.0 );
+    data.setClean( aFactorisationTime );
+    data.setClean( aFactorisationMemory );
     
     // probe weight computation
-    if(!data.isClean(aComputeWeight) || isNumProbeChanged){
+    bool neighbourWeighting = data.inputValue( aNeighbourWeighting ).asBool();
+    short weightMode = data.inputValue( aWeightMode ).asShort();
+    short normaliseWeightMode = data.inputValue( aNormaliseWeight ).asShort();
+    double effectRadius = data.inputValue( aEffectRadius ).asDouble();
+    if(cache.needs(ST_WEIGHT, (CacheKey() << weightMode << normaliseWeightMode << effectRadius << normExponent
+                               << weightPrecision << neighbourWeighting << areaWeighted << solverType << fillOrdering).value)){
         // load probe weights
         MArrayDataHandle handle = data.inputArrayValue(aProbeWeight);
         if(handle.elementCount() != numPrb){
@@ -229,56 +404,24 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
             isError = ERROR_ATTR;
             return MS::kFailure;
         }
-        double effectRadius = data.inputValue( aEffectRadius ).asDouble();
         std::vector<double> probeWeight(numPrb), probeRadius(numPrb);
         for(int i=0;i<numPrb;i++){
             handle.jumpToArrayElement(i);
             probeWeight[i] = handle.inputValue().asDouble();
             probeRadius[i] = probeWeight[i] * effectRadius;
         }
-        wr.resize(mesh.numTet);ws.resize(mesh.numTet);wl.resize(mesh.numTet);
-        for(int j=0;j<mesh.numTet;j++){
-            wr[j].resize(numPrb); ws[j].resize(numPrb); wl[j].resize(numPrb);
+        // a single weight field serves all channels unless the ramps differ
+        if(weightMode == WM_DRAW){
+            updateRampLUT(data, G);
         }
-        short weightMode = data.inputValue( aWeightMode ).asShort();
-        if (weightMode == WM_INV_DISTANCE){
-            for(int j=0;j<mesh.numTet;j++){
-                double sum=0.0;
-                std::vector<double> idist(numPrb);
-                for (int i = 0; i<numPrb; i++){
-                    idist[i] = probeRadius[i] / pow(D.distTet[i][j], normExponent);
-                    sum += idist[i];
-                }
-                for (int i = 0; i<numPrb; i++){
-                    wr[j][i] = ws[j][i] = wl[j][i] = sum > 0 ? idist[i] / sum : 0.0;
-                }
-            }
-        }
-        else if (weightMode == WM_CUTOFF_DISTANCE){
-            for(int j=0;j<mesh.numTet;j++){
-                for (int i = 0; i<numPrb; i++){
-                    wr[j][i] = ws[j][i] = wl[j][i] = (D.distTet[i][j] > probeRadius[i])
-                    ? 0 : pow((probeRadius[i] - D.distTet[i][j]) / probeRadius[i], normExponent);
-                }
-            }
-        }else if (weightMode == WM_DRAW){
-            float val;
-            MRampAttribute rWeightCurveR( thisNode, aWeightCurveR, &status );
-            MRampAttribute rWeightCurveS( thisNode, aWeightCurveS, &status );
-            MRampAttribute rWeightCurveL( thisNode, aWeightCurveL, &status );
-            for(int j=0;j<mesh.numTet;j++){
-                for (int i = 0; i < numPrb; i++){
-                    rWeightCurveR.getValueAtPosition(D.distTet[i][j] / probeRadius[i], val);
-                    wr[j][i] = val;
-                    rWeightCurveS.getValueAtPosition(D.distTet[i][j] / probeRadius[i], val);
-                    ws[j][i] = val;
-                    rWeightCurveL.getValueAtPosition(D.distTet[i][j] / probeRadius[i], val);
-                    wl[j][i] = val;
-                }
-            }
-        }else if(weightMode & WM_HARMONIC){
+        W.setNum(mesh.numTet, numPrb, weightMode != WM_DRAW || (G.lutR.table == G.lutS.table && G.lutR.table == G.lutL.table), weightPrecision);
+        if(weightMode & WM_HARMONIC){
             Laplacian harmonicWeighting;
-            makeFaceTet(data, input, inputGeom, mIndex, pts, harmonicWeighting.tetList, harmonicWeighting.tetMatrix, harmonicWeighting.tetWeight);
+            harmonicWeighting.setSolver(solverType, fillOrdering);
+            MeshTopology faceTopo;
+            faceTopo.faceList = G.faceList;
+            makeTetList(TM_FACE, numPts, faceTopo, harmonicWeighting.tetList);
+            makeTetMatrix(TM_FACE, pts, harmonicWeighting.tetList, faceTopo, harmonicWeighting.tetMatrix, harmonicWeighting.tetWeight);
             harmonicWeighting.numTet = (int)harmonicWeighting.tetList.size()/4;
             std::vector<T> weightConstraint(numPrb);
             // the vertex closest to the probe is given probeWeight
@@ -286,10 +429,10 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
                 weightConstraint[i]=T(i,D.closestPts[i],probeWeight[i]);
             }
             // vertices within effectRadius are given probeWeight
-            if( data.inputValue( aNeighbourWeighting ).asBool() ){
+            if( neighbourWeighting ){
                 for(int i=0;i<numPrb;i++){
                     for(int j=0;j<numPts;j++){
-                        if(D.distPts[i][j]<probeRadius[i]){
+                        if(D.distPts(i,j)<probeRadius[i]){
                             weightConstraint.push_back(T(i,j,probeWeight[i]));
                         }
                     }
@@ -319,70 +462,87 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
                 isError = harmonicWeighting.cotanPrecompute();
             }
             if(isError>0) return MS::kFailure;
-            std::vector< std::vector<double> > w_tet(numPrb);
-            harmonicWeighting.harmonicSolve();
-            for(int i=0;i<numPrb;i++){
-                makeTetWeightList(tetMode, mesh.tetList, faceList, edgeList, vertexList, harmonicWeighting.Sol.col(i), w_tet[i]);
-                for(int j=0;j<mesh.numTet; j++){
-                    wr[j][i] = ws[j][i] = wl[j][i] = w_tet[i][j];
+            // harmonic weights are streamed into the weight table of tets and normalised there row by row
+            W.startRows();
+            HarmonicStore store(tetMode, mesh.tetList, topo, W);
+            harmonicWeighting.harmonicSolve(store);
+            W.finishRows(RowNormaliser(D, normaliseWeightMode));
+        }else{
+            // compute, normalise and store weights row by row
+            const RampLUT* lut[3] = {&G.lutR, &G.lutS, &G.lutL};
+#pragma omp parallel for
+            for(int j=0;j<mesh.numTet;j++){
+                std::vector<double> w(numPrb);
+                for(int c=0;c<W.numChannel;c++){
+                    if (weightMode == WM_INV_DISTANCE){
+                        double sum=0.0;
+                        for (int i = 0; i<numPrb; i++){
+                            w[i] = probeRadius[i] / pow(D.distTet(i,j), normExponent);
+                            sum += w[i];
+                        }
+                        for (int i = 0; i<numPrb; i++){
+                            w[i] = sum > 0 ? w[i] / sum : 0.0;
+                        }
+                    }else if (weightMode == WM_CUTOFF_DISTANCE){
+                        for (int i = 0; i<numPrb; i++){
+                            w[i] = (D.distTet(i,j) > probeRadius[i])
+                            ? 0 : pow((probeRadius[i] - D.distTet(i,j)) / probeRadius[i], normExponent);
+                        }
+                    }else if (weightMode == WM_DRAW){
+                        for (int i = 0; i < numPrb; i++){
+                            w[i] = (*lut[c])(D.distTet(i,j) / probeRadius[i]);
+                        }
+                    }
+                    D.normaliseWeight(normaliseWeightMode, w);
+                    W.setRow(c, j, w);
                 }
             }
         }
-        // normalise weights
-        short normaliseWeightMode = data.inputValue( aNormaliseWeight ).asShort();
-        for(int j=0;j<mesh.numTet;j++){
-            D.normaliseWeight(normaliseWeightMode, wr[j]);
-            D.normaliseWeight(normaliseWeightMode, ws[j]);
-            D.normaliseWeight(normaliseWeightMode, wl[j]);
-        }
-        status = data.setClean(aComputeWeight);
+        cache.done(ST_WEIGHT);
+        data.outputValue( aWeightMemory ).set( (W.bytes() + D.distPts.bytes() + D.distTet.bytes()) / 1048576.0 );
+        data.setClean( aWeightMemory );
     } // END of weight computation
+    
+    // reduced subspace and the sample tets of the local step
+    ReducedARAP& reduced = G.reduced;
+    bool isReduced = data.inputValue( aReduced ).asBool();
+    bool reducedErrorCheck = isReduced && data.inputValue( aReducedErrorCheck ).asBool();
+    if(isReduced){
+        int numEigen = data.inputValue( aReducedModes ).asInt();
+        int numSample = data.inputValue( aReducedSamples ).asInt();
+        if(cache.needs(ST_REDUCTION, (CacheKey() << numEigen << numSample).value)){
+            isError = reduced.precompute(mesh, W, tetCenter, numEigen, numSample);
+            if(isError>0){
+                return MS::kFailure;
+            }
+            cache.done(ST_REDUCTION);
+        }
+    }
+    data.outputValue( aCacheStages ).set( MString(cache.log().c_str()) );
+    data.setClean( aCacheStages );
 
 
     // setting up transformation matrix
     B.rotationConsistency = data.inputValue( aRotationConsistency ).asBool();
     bool frechetSum = data.inputValue( aFrechetSum ).asBool();
-    blendedSE.resize(mesh.numTet); blendedR.resize(mesh.numTet); blendedS.resize(mesh.numTet); blendedL.resize(mesh.numTet);A.resize(mesh.numTet);
+    blendedR.resize(mesh.numTet); blendedS.resize(mesh.numTet); blendedL.resize(mesh.numTet);A.resize(mesh.numTet);
     for(int i=0;i<numPrb;i++){
         B.Aff[i]=initMatrix[i].inverse()*matrix[i];
     }
     B.parametrise(blendMode);
     
 
-// prepare transform matrix for each simplex
+// prepare transform matrix for each simplex; only the samples are needed by the reduced solver
+    bool isSampled = isReduced && !reducedErrorCheck;
+    int numBlend = isSampled ? reduced.numSample() : mesh.numTet;
+    G.scratch.resize(3, numPrb);
 #pragma omp parallel for
-	for (int j = 0; j < mesh.numTet; j++){
-		// blend matrix
-		if (blendMode == BM_SRL){
-			blendedS[j] = expSym(blendMat(B.logS, ws[j]));
-			Vector3d l = blendMat(B.L, wl[j]);
-            blendedR[j] = frechetSum ? frechetSO(B.R, wr[j]) : expSO(blendMat(B.logR, wr[j]));
-			A[j] = pad(blendedS[j]*blendedR[j], l);
-		}
-		else if (blendMode == BM_SSE){
-			blendedS[j] = expSym(blendMat(B.logS, ws[j]));
-            blendedSE[j] = expSE(blendMat(B.logSE, wr[j]));
-			A[j] = pad(blendedS[j], Vector3d::Zero()) * blendedSE[j];
-		}
-		else if (blendMode == BM_LOG3){
-			blendedR[j] = blendMat(B.logGL, wr[j]).exp();
-			Vector3d l = blendMat(B.L, wl[j]);
-			A[j] = pad(blendedR[j], l);
-		}
-		else if (blendMode == BM_LOG4){
-			A[j] = blendMat(B.logAff, wr[j]).exp();
-		}
-		else if (blendMode == BM_SQL){
-			Vector4d q = blendQuat(B.quat, wr[j]);
-			Vector3d l = blendMat(B.L, wl[j]);
-			blendedS[j] = blendMatLin(B.S, ws[j]);
-			Quaternion<double> RQ(q);
-			blendedR[j] = RQ.matrix().transpose();
-			A[j] = pad(blendedS[j]*blendedR[j], l);
-		}
-		else if (blendMode == BM_AFF){
-			A[j] = blendMatLin(B.Aff, wr[j]);
-		}
+	for (int s = 0; s < numBlend; s++){
+        int j = isSampled ? reduced.sampleTet[s] : s;
+        const std::vector<double> &wr = W.row(WC_ROTATION, j, G.scratch.get(0));
+        const std::vector<double> &ws = W.isShared() ? wr : W.row(WC_SHEAR, j, G.scratch.get(1));
+        const std::vector<double> &wl = W.isShared() ? wr : W.row(WC_TRANSLATION, j, G.scratch.get(2));
+        A[j] = B.blend(blendMode, frechetSum, wr, ws, wl, blendedS[j], blendedR[j]);
 	}
 
     // compute target vertices position
@@ -400,57 +560,109 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
     }
 
     // iterate to determine vertices position
-    for(int k=0;k<numIter;k++){
-        // solve ARAP
-        mesh.ARAPSolve(A);
-        // set new vertices position
-        new_pts.resize(numPts);
-        for(int i=0;i<numPts;i++){
-            new_pts[i][0]=mesh.Sol(i,0);
-            new_pts[i][1]=mesh.Sol(i,1);
-            new_pts[i][2]=mesh.Sol(i,2);
-        }
-        // if iteration continues
-        if(k+1<numIter || visualisationMode == VM_ENERGY){
-            std::vector<double> dummy_weight;
-            makeTetMatrix(tetMode, new_pts, mesh.tetList, faceList, edgeList, vertexList, Q, dummy_weight);
-            Matrix3d S,R,newS,newR;
-            if(blendMode == BM_AFF || blendMode == BM_LOG4 || blendMode == BM_LOG3){
+    if(isReduced){
+        reduced.setTargets(A);
+    }
+    if(!isReduced || reducedErrorCheck){
+        for(int k=0;k<numIter;k++){
+            // solve ARAP
+            mesh.ARAPSolve(A);
+            data.outputValue( aSolveResidual ).set( mesh.solver->residual );
+            data.setClean( aSolveResidual );
+            // set new vertices position
+            new_pts.resize(numPts);
+            for(int i=0;i<numPts;i++){
+                new_pts[i][0]=mesh.Sol(i,0);
+                new_pts[i][1]=mesh.Sol(i,1);
+                new_pts[i][2]=mesh.Sol(i,2);
+            }
+            // if iteration continues
+            if(k+1<numIter || visualisationMode == VM_ENERGY){
+                makeTetMatrix(tetMode, new_pts, mesh.tetList, topo, Q, G.dummyWeight);
+                if(blendMode == BM_AFF || blendMode == BM_LOG4 || blendMode == BM_LOG3){
+                    for(int i=0;i<mesh.numTet;i++){
+                        polarHigham(A[i].block(0,0,3,3), blendedS[i], blendedR[i]);
+                    }
+                }
+                #pragma omp parallel for
                 for(int i=0;i<mesh.numTet;i++){
-                    polarHigham(A[i].block(0,0,3,3), blendedS[i], blendedR[i]);
+                    Matrix3d newS,newR;
+                    polarHigham((mesh.tetMatrixInverse[i]*Q[i]).block(0,0,3,3), newS, newR);
+                    tetEnergy[i] = (newS-blendedS[i]).squaredNorm();
+                    A[i].block(0,0,3,3) = blendedS[i]*newR;
+//                    polarHigham((A[i].transpose()*PI[i]*Q[i]).block(0,0,3,3), newS, newR);
+//                    A[i].block(0,0,3,3) *= newR;
+                }
+            }
+        }
+    }
+    // the reduced solver iterates only at the samples, whose energy is shared by their clusters
+    if(isReduced){
+        MatrixXd& fullSol = G.fullSol;
+        if(reducedErrorCheck){
+            fullSol = mesh.Sol;
+        }
+        int numSample = reduced.numSample();
+        std::vector<double>& sampleEnergy = G.sampleEnergy;
+        sampleEnergy.assign(numSample, 0.0);
+        if(blendMode == BM_AFF || blendMode == BM_LOG4 || blendMode == BM_LOG3){
+            for(int s=0;s<numSample;s++){
+                int j = reduced.sampleTet[s];
+                polarHigham(reduced.sampleTarget[s].block(0,0,3,3), blendedS[j], blendedR[j]);
+            }
+        }
+        for(int k=0;k<numIter;k++){
+            reduced.solve(mesh.constraintVal);
+            if(k+1<numIter || visualisationMode == VM_ENERGY){
+                #pragma omp parallel for
+                for(int s=0;s<numSample;s++){
+                    int j = reduced.sampleTet[s];
+                    Matrix3d newS,newR;
+                    polarHigham((mesh.tetMatrixInverse[j]*reduced.sampleMatrix(s)).block(0,0,3,3), newS, newR);
+                    sampleEnergy[s] = (newS-blendedS[j]).squaredNorm();
+                    reduced.sampleTarget[s].block(0,0,3,3) = blendedS[j]*newR;
                 }
             }
-            #pragma omp parallel for
+        }
+        reduced.expand(mesh.Sol);
+        if(visualisationMode == VM_ENERGY){
             for(int i=0;i<mesh.numTet;i++){
-                polarHigham((mesh.tetMatrixInverse[i]*Q[i]).block(0,0,3,3), newS, newR);
-                tetEnergy[i] = (newS-blendedS[i]).squaredNorm();
-                A[i].block(0,0,3,3) = blendedS[i]*newR;
-//                polarHigham((A[i].transpose()*PI[i]*Q[i]).block(0,0,3,3), newS, newR);
-//                A[i].block(0,0,3,3) *= newR;
+                tetEnergy[i] = sampleEnergy[reduced.cluster[i]];
+            }
+        }
+        // largest deviation of a vertex from full ARAP relative to the diagonal of the bounding box
+        if(reducedErrorCheck){
+            Vector3d lower = pts[0], upper = pts[0];
+            for(int i=0;i<numPts;i++){
+                lower = lower.cwiseMin(pts[i]);
+                upper = upper.cwiseMax(pts[i]);
             }
+            double deviation = (mesh.Sol.topRows(numPts)-fullSol.topRows(numPts)).rowwise().norm().maxCoeff();
+            data.outputValue( aReducedError ).set( deviation / std::max((upper-lower).norm(), EPSILON) );
+            data.setClean( aReducedError );
         }
     }
+    Matrix4d worldToLocal = toMatrix4d(localToWorldMatrix).inverse();
+#pragma omp parallel for
     for(int i=0;i<numPts;i++){
-        Mpts[i].x=mesh.Sol(i,0);
-        Mpts[i].y=mesh.Sol(i,1);
-        Mpts[i].z=mesh.Sol(i,2);
+        int v = newIndex[i];
+        RowVector4d p(mesh.Sol(v,0), mesh.Sol(v,1), mesh.Sol(v,2), 1.0);
+        if(worldMode)
+            p = p * worldToLocal;
+        points.set(i, p);
     }
-    if(worldMode){
-        for(int i=0;i<numPts;i++)
-            Mpts[i] *= localToWorldMatrix.inverse();
-    }
-    itGeo.setAllPositions(Mpts);
+    points.write(itGeo);
     
     // set vertex colour
     if(visualisationMode != VM_OFF){
         std::vector<double> ptsColour(numPts, 0.0);
         if(visualisationMode == VM_ENERGY){
-            makePtsWeightList(tetMode, numPts, mesh.tetList, faceList, edgeList, vertexList, tetEnergy, ptsColour);
+            makePtsWeightList(tetMode, numPts, mesh.tetList, topo, tetEnergy, ptsColour);
             for(int i=0;i<numPts;i++){
                 ptsColour[i] *= visualisationMultiplier;
             }
         }else if(visualisationMode == VM_STIFFNESS){
-            makePtsWeightList(tetMode, numPts, mesh.tetList, faceList, edgeList, vertexList, mesh.tetWeight, ptsColour);
+            makePtsWeightList(tetMode, numPts, mesh.tetList, topo, mesh.tetWeight, ptsColour);
             double maxval = *std::max_element(ptsColour.begin(), ptsColour.end());
             for(int i=0;i<numPts;i++){
                 ptsColour[i] = 1.0 - ptsColour[i]/maxval;
@@ -463,11 +675,16 @@ MStatus probeDeformerARAPNode::deform( MDataBlock& data, MItGeometry& itGeo, con
             std:vector<double> wsum(mesh.numTet);
             for(int j=0;j<mesh.numTet;j++){
                 //wsum[j] = std::accumulate(wr[j].begin(), wr[j].end(), 0.0);
-                wsum[j]= visualisationMultiplier * wr[j][numPrb-1];
+                wsum[j]= visualisationMultiplier * W(WC_ROTATION,j,numPrb-1);
             }
-            makePtsWeightList(tetMode, numPts, mesh.tetList, faceList, edgeList, vertexList, wsum, ptsColour);
+            makePtsWeightList(tetMode, numPts, mesh.tetList, topo, wsum, ptsColour);
         }
-        visualise(data, outputGeom, ptsColour);
+        // back to the order of Maya
+        std::vector<double> mayaColour(numPts);
+        for(int i=0;i<numPts;i++){
+            mayaColour[i] = ptsColour[newIndex[i]];
+        }
+        visualise(data, outputGeom, mIndex, mayaColour);
     }
     
     return MS::kSuccess;
@@ -484,20 +701,123 @@ MStatus probeDeformerARAPNode::initialize(){
     MFnMatrixAttribute mAttr;
    	MRampAttribute rAttr;
 
-    // this attr will be dirtied when ARAP recomputation is needed
+    // this attr will be dirtied when the stiffness or constraint inputs given as arrays or meshes are changed.
+    // scalar attributes are compared by the keys of the cache stages
     aARAP = nAttr.create( "arap", "arap", MFnNumericData::kBoolean, true );
     nAttr.setStorable(false);
     nAttr.setKeyable(false);
     nAttr.setHidden(true);
     addAttribute( aARAP );
 
-    // this attr will be dirtied when weight recomputation is needed
+    // this attr will be dirtied when the probe weights or the ramp curves are changed
     aComputeWeight = nAttr.create( "computeWeight", "computeWeight", MFnNumericData::kBoolean, true );
     nAttr.setStorable(false);
     nAttr.setKeyable(false);
     nAttr.setHidden(true);
     addAttribute( aComputeWeight );
 
+    // this attr will be dirtied when painted weights are changed
+    aPaintedWeight = nAttr.create( "paintedWeight", "paintedWeight", MFnNumericData::kBoolean, true );
+    nAttr.setStorable(false);
+    nAttr.setKeyable(false);
+    nAttr.setHidden(true);
+    addAttribute( aPaintedWeight );
+    attributeAffects( weightList, aPaintedWeight );
+
+    // this attr will be dirtied when the ramp curves are changed
+    aRampLUT = nAttr.create( "rampLUT", "rampLUT", MFnNumericData::kBoolean, true );
+    nAttr.setStorable(false);
+    nAttr.setKeyable(false);
+    nAttr.setHidden(true);
+    addAttribute( aRampLUT );
+
+    aSolver = eAttr.create( "solver", "slv", SOLVER_LDLT );
+    eAttr.addField( "SimplicialLDLT", SOLVER_LDLT );
+    eAttr.addField( "SimplicialLLT", SOLVER_LLT );
+    eAttr.addField( "SparseLU", SOLVER_LU );
+    eAttr.addField( "CHOLMOD", SOLVER_CHOLMOD );
+    eAttr.addField( "CG", SOLVER_CG );
+    eAttr.addField( "multigrid", SOLVER_MG );
+    eAttr.addField( "CG multigrid", SOLVER_CG_MG );
+    eAttr.addField( "CG Schwarz", SOLVER_SCHWARZ );
+    eAttr.setStorable(true);
+    addAttribute( aSolver );
+    attributeAffects( aSolver, outputGeom );
+
+    aFillOrdering = eAttr.create( "fillOrdering", "fo", FO_AMD );
+    eAttr.addField( "AMD", FO_AMD );
+    eAttr.addField( "natural", FO_NATURAL );
+    eAttr.setStorable(true);
+    addAttribute( aFillOrdering );
+    attributeAffects( aFillOrdering, outputGeom );
+
+    // factorise the ARAP system in single precision and refine the solution in double
+    aMixedPrecision = nAttr.create( "mixedPrecision", "mxp", MFnNumericData::kBoolean, false );
+    nAttr.setStorable(true);
+    addAttribute( aMixedPrecision );
+    attributeAffects( aMixedPrecision, outputGeom );
+
+    // the multigrid and Schwarz solvers apply the ARAP matrix tet by tet instead of keeping it
+    aMatrixFree = nAttr.create( "matrixFree", "mfr", MFnNumericData::kBoolean, false );
+    nAttr.setStorable(true);
+    addAttribute( aMatrixFree );
+    attributeAffects( aMatrixFree, outputGeom );
+
+    aVertexOrdering = eAttr.create( "vertexOrdering", "vo", VO_NONE );
+    eAttr.addField( "none", VO_NONE );
+    eAttr.addField( "RCM", VO_RCM );
+    eAttr.addField( "Morton", VO_MORTON );
+    eAttr.setStorable(true);
+    addAttribute( aVertexOrdering );
+    attributeAffects( aVertexOrdering, outputGeom );
+
+    // time (sec) and memory (MB) of the last factorisation
+    aFactorisationTime = nAttr.create("factorisationTime", "fct", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aFactorisationTime );
+    aFactorisationMemory = nAttr.create("factorisationMemory", "fcm", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aFactorisationMemory );
+    // relative residual of the last ARAP solve
+    aSolveResidual = nAttr.create("solveResidual", "slr", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aSolveResidual );
+
+    // ARAP in a subspace spanned by the linear blend modes of the probes and smooth eigenvectors,
+    // with the local step evaluated at sample tets
+    aReduced = nAttr.create( "reducedSubspace", "rds", MFnNumericData::kBoolean, false );
+    nAttr.setStorable(true);
+    addAttribute( aReduced );
+    attributeAffects( aReduced, outputGeom );
+    aReducedModes = nAttr.create( "reducedEigenModes", "rdm", MFnNumericData::kInt, 16 );
+    nAttr.setMin( 0 );
+    nAttr.setStorable(true);
+    addAttribute( aReducedModes );
+    attributeAffects( aReducedModes, outputGeom );
+    aReducedSamples = nAttr.create( "reducedSamples", "rdsm", MFnNumericData::kInt, 1000 );
+    nAttr.setMin( 1 );
+    nAttr.setStorable(true);
+    addAttribute( aReducedSamples );
+    attributeAffects( aReducedSamples, outputGeom );
+    // full ARAP is also solved to measure the error of the reduced solution
+    aReducedErrorCheck = nAttr.create( "reducedErrorCheck", "rdec", MFnNumericData::kBoolean, false );
+    nAttr.setStorable(true);
+    addAttribute( aReducedErrorCheck );
+    attributeAffects( aReducedErrorCheck, outputGeom );
+    aReducedError = nAttr.create("reducedError", "rde", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aReducedError );
+
+    // names of the precomputation stages run in the last evaluation
+    aCacheStages = tAttr.create( "cacheStages", "cstg", MFnData::kString );
+    tAttr.setStorable(false);
+    tAttr.setWritable(false);
+    addAttribute( aCacheStages );
+
     aMatrix = mAttr.create("probeMatrix", "pm");
     mAttr.setStorable(false);
     mAttr.setHidden(true);
@@ -547,7 +867,19 @@ MStatus probeDeformerARAPNode::initialize(){
     eAttr.setStorable(true);
     addAttribute( aNormaliseWeight );
     attributeAffects( aNormaliseWeight, outputGeom );
-    attributeAffects( aNormaliseWeight, aComputeWeight );
+
+    aWeightPrecision = eAttr.create( "weightPrecision", "wp", WP_DOUBLE );
+    eAttr.addField( "double", WP_DOUBLE );
+    eAttr.addField( "float", WP_FLOAT );
+    eAttr.addField( "fixed16", WP_FIXED16 );
+    eAttr.setStorable(true);
+    addAttribute( aWeightPrecision );
+    attributeAffects( aWeightPrecision, outputGeom );
+    // memory (MB) of the weight and distance tables
+    aWeightMemory = nAttr.create("weightMemory", "wmm", MFnNumericData::kDouble, 0.0);
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    addAttribute( aWeightMemory );
 
     aWeightMode = eAttr.create( "weightMode", "wtm", WM_HARMONIC_COTAN );
     eAttr.addField( "inverse", WM_INV_DISTANCE );
@@ -559,7 +891,6 @@ MStatus probeDeformerARAPNode::initialize(){
     eAttr.setKeyable(false);
     addAttribute( aWeightMode );
     attributeAffects( aWeightMode, outputGeom );
-    attributeAffects( aWeightMode, aComputeWeight );
     
     aConstraintMode = eAttr.create( "constraintMode", "ctm", CONSTRAINT_CLOSEST );
     eAttr.addField( "neighbour",  CONSTRAINT_NEIGHBOUR);
@@ -568,7 +899,6 @@ MStatus probeDeformerARAPNode::initialize(){
     eAttr.setKeyable(false);
     addAttribute( aConstraintMode );
     attributeAffects( aConstraintMode, outputGeom );
-    attributeAffects( aConstraintMode, aARAP);
 
     aTetMode = eAttr.create( "tetMode", "tm", TM_FACE );
     eAttr.addField( "face", TM_FACE );
@@ -579,54 +909,43 @@ MStatus probeDeformerARAPNode::initialize(){
     eAttr.setKeyable(false);
     addAttribute( aTetMode );
     attributeAffects( aTetMode, outputGeom );
-    attributeAffects( aTetMode, aARAP );
-    attributeAffects( aTetMode, aComputeWeight );
 
 	aWorldMode = nAttr.create( "worldMode", "wrldmd", MFnNumericData::kBoolean, true );
     nAttr.setStorable(true);
     nAttr.setKeyable(false);
     addAttribute( aWorldMode );
     attributeAffects( aWorldMode, outputGeom );
-    attributeAffects( aWorldMode, aARAP );
     
 	aEffectRadius = nAttr.create("effectRadius", "er", MFnNumericData::kDouble, 8.0);
     nAttr.setMin( EPSILON );
     nAttr.setStorable(true);
 	addAttribute( aEffectRadius );
 	attributeAffects( aEffectRadius, outputGeom );
-	attributeAffects( aEffectRadius, aComputeWeight );
     
 	aTransWeight = nAttr.create("translationWeight", "tw", MFnNumericData::kDouble, 1e-20);
     nAttr.setStorable(true);
 	addAttribute( aTransWeight );
 	attributeAffects( aTransWeight, outputGeom );
-	attributeAffects( aTransWeight, aARAP );
 
     aAreaWeighted = nAttr.create( "areaWeighted", "aw", MFnNumericData::kBoolean, false );
     nAttr.setStorable(true);
     addAttribute( aAreaWeighted );
     attributeAffects( aAreaWeighted, outputGeom );
-    attributeAffects( aAreaWeighted, aARAP );
 
     aNeighbourWeighting = nAttr.create( "neighbourWeighting", "nghbrw", MFnNumericData::kBoolean, false );
     nAttr.setStorable(true);
     addAttribute( aNeighbourWeighting );
     attributeAffects( aNeighbourWeighting, outputGeom );
-    attributeAffects( aNeighbourWeighting, aComputeWeight );
-    attributeAffects( aNeighbourWeighting, aARAP );
 
 	aConstraintWeight = nAttr.create("constraintWeight", "cw", MFnNumericData::kDouble, 1.0);
     nAttr.setStorable(true);
 	addAttribute( aConstraintWeight );
 	attributeAffects( aConstraintWeight, outputGeom );
-	attributeAffects( aConstraintWeight, aARAP );
     
 	aNormExponent = nAttr.create("normExponent", "ne", MFnNumericData::kDouble, 1.0);
     nAttr.setStorable(true);
 	addAttribute( aNormExponent );
 	attributeAffects( aNormExponent, outputGeom );
-	attributeAffects( aNormExponent, aARAP );
-	attributeAffects( aNormExponent, aComputeWeight );
     
 	aIteration = nAttr.create("iteration", "it", MFnNumericData::kShort, 1);
     nAttr.setStorable(true);
@@ -637,7 +956,6 @@ MStatus probeDeformerARAPNode::initialize(){
     nAttr.setStorable(true);
 	addAttribute( aConstraintRadius );
 	attributeAffects( aConstraintRadius, outputGeom );
-	attributeAffects( aConstraintRadius, aARAP );
 
     aVisualisationMode = eAttr.create( "visualisationMode", "vm", VM_OFF );
     eAttr.addField( "off", VM_OFF );
@@ -661,7 +979,6 @@ MStatus probeDeformerARAPNode::initialize(){
     eAttr.setStorable(true);
     addAttribute( aStiffness );
     attributeAffects( aStiffness, outputGeom );
-    attributeAffects( aStiffness, aARAP );
     
 	aSupervisedMesh = tAttr.create("supervisedMesh", "svmesh", MFnData::kMesh);
     tAttr.setStorable(true);
@@ -692,14 +1009,57 @@ MStatus probeDeformerARAPNode::initialize(){
     addAttribute( aWeightCurveR );
 	attributeAffects( aWeightCurveR, outputGeom );
 	attributeAffects( aWeightCurveR, aComputeWeight );
+	attributeAffects( aWeightCurveR, aRampLUT );
     aWeightCurveS = rAttr.createCurveRamp( "weightCurveShear", "wcs" );
     addAttribute( aWeightCurveS );
 	attributeAffects( aWeightCurveS, outputGeom );
 	attributeAffects( aWeightCurveS, aComputeWeight );
+	attributeAffects( aWeightCurveS, aRampLUT );
     aWeightCurveL = rAttr.createCurveRamp( "weightCurveTranslation", "wcl" );
     addAttribute( aWeightCurveL );
 	attributeAffects( aWeightCurveL, outputGeom );
 	attributeAffects( aWeightCurveL, aComputeWeight );
+	attributeAffects( aWeightCurveL, aRampLUT );
+
+    aRampResolution = nAttr.create("rampResolution", "rres", MFnNumericData::kInt, 256);
+    nAttr.setMin( 2 );
+    nAttr.setStorable(true);
+	addAttribute( aRampResolution );
+	attributeAffects( aRampResolution, outputGeom );
+	attributeAffects( aRampResolution, aComputeWeight );
+	attributeAffects( aRampResolution, aRampLUT );
+
+    // the statistics are written by deform(); they are dirtied by the inputs they report on
+    // and hold the values of the last deformation
+    attributeAffects( aComputeWeight, aWeightMemory );
+    attributeAffects( aWeightPrecision, aWeightMemory );
+    attributeAffects( aARAP, aFactorisationTime );
+    attributeAffects( aARAP, aFactorisationMemory );
+    attributeAffects( aSolver, aFactorisationTime );
+    attributeAffects( aSolver, aFactorisationMemory );
+    attributeAffects( aFillOrdering, aFactorisationTime );
+    attributeAffects( aFillOrdering, aFactorisationMemory );
+    attributeAffects( aMixedPrecision, aFactorisationTime );
+    attributeAffects( aMixedPrecision, aFactorisationMemory );
+    attributeAffects( aMatrixFree, aFactorisationTime );
+    attributeAffects( aMatrixFree, aFactorisationMemory );
+    attributeAffects( aTransWeight, aFactorisationTime );
+    attributeAffects( aTransWeight, aFactorisationMemory );
+    attributeAffects( aMatrix, aSolveResidual );
+    attributeAffects( aIteration, aSolveResidual );
+    attributeAffects( aSolver, aSolveResidual );
+    attributeAffects( aMixedPrecision, aSolveResidual );
+    attributeAffects( aMatrixFree, aSolveResidual );
+    attributeAffects( aMatrix, aReducedError );
+    attributeAffects( aReduced, aReducedError );
+    attributeAffects( aReducedModes, aReducedError );
+    attributeAffects( aReducedSamples, aReducedError );
+    attributeAffects( aReducedErrorCheck, aReducedError );
+    // the stages run are logged at every deformation
+    attributeAffects( aMatrix, aCacheStages );
+    attributeAffects( aInitMatrix, aCacheStages );
+    attributeAffects( aARAP, aCacheStages );
+    attributeAffects( aComputeWeight, aCacheStages );
     
     // Make the deformer weights paintable
     MGlobal::executeCommand( "makePaintable -attrType multiFloat -sm deformer probeDeformerARAP weights;" );
@@ -13,17 +13,68 @@
 #include "../tetrise.h"
 #include "../MeshMaya.h"
 #include "../laplacian.h"
+#include "../reducedARAP.h"
 #include "../blendAff.h"
 #include "../distance.h"
+#include "../probeWeight.h"
+#include "../cacheGraph.h"
 
 using namespace Eigen;
 
 
+// cached data for each deformed geometry (indexed by mIndex)
+class probeDeformerARAPGeom
+{
+public:
+    probeDeformerARAPGeom(): isError(0), numPrb(0), topologyHash(0), isTopologyDirty(true), isPaintDirty(true) {
+        // registered in the order of ST_*
+        cache.addStage("topology");
+        cache.addStage("rest", ST_TOPOLOGY);
+        cache.addStage("distance", ST_REST);
+        cache.addStage("stiffness", ST_REST);
+        cache.addStage("constraint", ST_DISTANCE);
+        cache.addStage("factorisation", ST_STIFFNESS, ST_CONSTRAINT);
+        cache.addStage("weight", ST_DISTANCE);
+        cache.addStage("reduction", ST_FACTORISATION, ST_WEIGHT);
+    };
+    BlendAff B;
+    Distance D;
+    Laplacian mesh;
+    ReducedARAP reduced;   // subspace of the reduced solver
+    std::vector<Vector3d> tetCenter; // center of tets
+    MeshTopology meshTopo;   // topology of the input mesh
+    MeshTopology topo;   // topology in the new vertex order without degenerate tets
+    std::vector<int> newIndex;   // new index of each vertex of Maya
+    std::vector<int> faceList;   // all the faces in the new vertex order
+    std::vector<Vector3d> pts, new_pts;   // coordinates for mesh points
+    ProbeWeight W;    // weights of probes on tets
+    RampLUT lutR, lutS, lutL;   // copies of the sampled weight curves used by this geometry
+    short isError;  // to catch error
+    int numPrb;  // number of probes
+    std::vector<T> constraint;  // [row,col,value): row probe constraints col point with strength value
+    std::vector<Matrix4d> A,Q;  //temporary
+    BlendScratch scratch;   // per-thread weight rows
+    std::vector<Matrix3d> blendedR, blendedS;
+    std::vector<Vector4d> blendedL;
+    std::vector<double> tetEnergy;
+    std::vector<double> sampleEnergy;   // energy at the samples of the reduced solver
+    MatrixXd fullSol;   // full ARAP solution to measure the error of the reduced solver
+    std::vector<double> dummyWeight;
+    std::vector<Matrix4d> initMatrix, matrix;
+    PointBuffer points;
+    CacheGraph cache;   // stages of the precomputation of this geometry
+    unsigned long long topologyHash;   // hash of the connectivity meshTopo was made from
+    bool isTopologyDirty;   // the connectivity has to be hashed again
+    std::vector<double> restTetWeight;   // volume of tets
+    bool isPaintDirty;   // painted weights have to be reloaded
+    std::vector<double> ptsWeight;   // painted weights
+};
+
 //deformer
 class probeDeformerARAPNode : public MPxDeformerNode
 {
 public:
-    probeDeformerARAPNode(): numPrb(0), isError(0)  {};
+    probeDeformerARAPNode() {};
     virtual MStatus deform( MDataBlock& data, MItGeometry& itGeo, const MMatrix &localToWorldMatrix, unsigned int mIndex );
 	virtual MStatus accessoryNodeSetup( MDagModifier& cmd );
     void    postConstructor();
@@ -34,6 +85,9 @@ public:
     static MString      nodeName;
     static MObject      aARAP;   // this attr will be dirtied when ARAP recomputation is needed
     static MObject      aComputeWeight; // this attr will be dirtied when weight recomputation is needed
+    static MObject      aPaintedWeight; // this attr will be dirtied when painted weights are changed
+    static MObject      aRampLUT; // this attr will be dirtied when the ramp curves are changed
+    static MObject      aRampResolution; // number of samples of the ramp lookup tables
     static MObject      aInitMatrix;
     static MObject      aMatrix;
     static MObject      aBlendMode;
@@ -59,26 +113,29 @@ public:
     static MObject      aProbeWeight;
     static MObject      aProbeConstraintRadius;
     static MObject      aNormaliseWeight;
+    static MObject      aWeightPrecision;
+    static MObject      aWeightMemory;
     static MObject      aAreaWeighted;
     static MObject      aNeighbourWeighting;
+    static MObject      aSolver;
+    static MObject      aFillOrdering;
+    static MObject      aMixedPrecision;
+    static MObject      aMatrixFree;
+    static MObject      aVertexOrdering;
+    static MObject      aFactorisationTime;
+    static MObject      aFactorisationMemory;
+    static MObject      aSolveResidual;
+    static MObject      aReduced;
+    static MObject      aReducedModes;
+    static MObject      aReducedSamples;
+    static MObject      aReducedErrorCheck;
+    static MObject      aReducedError;   // relative deviation of the reduced solution from full ARAP
+    static MObject      aCacheStages;   // precomputation stages run in the last evaluation
     
 private:
-    // variables
-    BlendAff B;
-    Distance D;
-    Laplacian mesh;
-    std::vector<Vector3d> tetCenter; // center of tets
-    std::vector<vertex> vertexList;   // mesh data
-    std::vector<edge> edgeList;   // mesh data
-    std::vector<int> faceList;   // mesh data
-    std::vector<Vector3d> pts, new_pts;   // coordinates for mesh points
-    std::vector< std::vector<double> > wr, ws, wl; // wr[j][i] is the weight of ith probe on j-th tet
-    short isError;  // to catch error
-    int numPrb;  // number of probes
-    std::vector<T> constraint;  // [row,col,value): row probe constraints col point with strength value
-    std::vector<Matrix4d> A,Q, blendedSE;  //temporary
-    std::vector<Matrix3d> blendedR, blendedS;
-    std::vector<Vector4d> blendedL;
-    std::vector<double> tetEnergy;
-    
+    probeDeformerARAPGeom& getGeom(MDataBlock& data, unsigned int mIndex);
+    void updateRampLUT(MDataBlock& data, probeDeformerARAPGeom& G);
+    RampLUT lutR, lutS, lutL;   // sampled weight curves, guarded by geomLock
+    std::map<unsigned int, probeDeformerARAPGeom> geom;   // cache for each input geometry
+    MMutexLock geomLock;   // guards geom and the dirty flags
 };
@@ -167,6 +167,42 @@ namespace AffineLib{
     }
 
     
+    template<typename T>
+    T logMat(const T& m, const int maxSqrt=40)
+    /** principal log of a fixed size matrix by inverse scaling and squaring,
+     * which unlike Eigen's MatrixFunctions does not allocate
+     * @param m square matrix without eigenvalues on the closed negative real axis
+     * @param maxSqrt maximum number of square roots taken
+     * @return log(m)
+     */
+    {
+        const T I = T::Identity();
+        T X = m;
+        int k = 0;
+        // square roots by the Denman-Beavers iteration until X is close to the identity
+        while( (X-I).norm() > 0.25 && k < maxSqrt){
+            T Y = X, Z = I;
+            for(int j=0;j<50;j++){
+                T Yn = 0.5*(Y + Z.inverse());
+                Z = 0.5*(Z + Y.inverse());
+                bool isConverged = (Yn-Y).norm() < 1e-15 * Yn.norm();
+                Y = Yn;
+                if(isConverged) break;
+            }
+            X = Y;
+            k++;
+        }
+        // log(X) = 2 atanh(W) with W = (X-I)(X+I)^{-1}
+        T W = (X-I)*(X+I).inverse();
+        T W2 = W*W;
+        T term = W, A = W;
+        for(int j=1;j<30 && term.norm() > EPSILON;j++){
+            term = term*W2;
+            A += term/(2*j+1);
+        }
+        return ldexp(2.0, k) * A;
+    }
+
     Matrix3d expSO(const Matrix3d& m)
     /** exp for an anti-symmetric matrix using Rodrigues' formula
      * @param m anti-symmetric matrix
@@ -379,7 +415,7 @@ namespace AffineLib{
         for(int i=0;i<max_step;i++){
             Matrix3d W = Matrix3d::Zero();
             Matrix3d ZI = Z.transpose();
-            for(int j=0;j<m.size();j++){
+            for(int j=0;j<(int)m.size();j++){
                 W += w[j] * logSO(ZI * m[j]);
             }
             W = (W-W.transpose())/2;
@@ -405,7 +441,7 @@ namespace AffineLib{
         for(int i=0;i<max_step;i++){
             Matrix3d W = Matrix3d::Zero();
             Matrix3d ZI = Z.inverse();
-            for(int j=0;j<m.size();j++){
+            for(int j=0;j<(int)m.size();j++){
                 W += w[j] * logSym(ZI * m[j], e);
             }
             W = (W+W.transpose())/2;
@@ -579,7 +615,7 @@ namespace AffineLib{
      */
         assert(A.size() == weight.size());
         T X=T::Zero();
-        for(int i=0;i<A.size();i++){
+        for(int i=0;i<(int)A.size();i++){
             X += weight[i]*A[i];
         }
         return X;
@@ -596,7 +632,7 @@ namespace AffineLib{
         assert(A.size() == weight.size());
         T X=T::Zero();
         double sum = 0.0;
-        for(int i=0;i<A.size();i++){
+        for(int i=0;i<(int)A.size();i++){
             X += weight[i]*A[i];
             sum += weight[i];
         }
@@ -615,7 +651,7 @@ namespace AffineLib{
         Vector4d I(0,0,0,1);
         Vector4d X=Vector4d::Zero();
         double sum = 0.0;
-        for(int i=0;i<A.size();i++){
+        for(int i=0;i<(int)A.size();i++){
             X += weight[i] * A[i];
             sum += weight[i];
         }
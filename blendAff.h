@@ -12,6 +12,10 @@
 
 #include <map>
 #include <Eigen/Sparse>
+#include <unsupported/Eigen/MatrixFunctions>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "affinelib.h"
 #include "deformerConst.h"
 
@@ -44,8 +48,69 @@ public:
     }
     void parametrise(int mode);
     void clearRotation();
+    // blend the parametrised probes with the weights of the rotation, shear and translation channels.
+    // The blended shear and rotation parts are stored in S and R for the modes which compute them.
+    Matrix4d blend(int mode, bool frechetSum, const std::vector<double>& wr, const std::vector<double>& ws,
+                   const std::vector<double>& wl, Matrix3d& S, Matrix3d& R) const;
 };
 
+// per-thread scratch arrays of weights so that blending loops do not allocate
+class BlendScratch {
+public:
+    std::vector< std::vector<double> > buf;   // [thread*numChannel+channel]
+    int numChannel;
+    BlendScratch(): numChannel(0) {};
+    // reallocates only when the shape changes
+    void resize(int _numChannel, int n){
+        int numThreads = 1;
+#ifdef _OPENMP
+        numThreads = omp_get_max_threads();
+#endif
+        numChannel = _numChannel;
+        buf.resize(numThreads * numChannel);
+        for(int i=0;i<(int)buf.size();i++){
+            buf[i].resize(n);
+        }
+    }
+    // buffer of the calling thread
+    std::vector<double>& get(int channel){
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        return buf[thread*numChannel+channel];
+    }
+};
+
+
+Matrix4d BlendAff::blend(int mode, bool frechetSum, const std::vector<double>& wr, const std::vector<double>& ws,
+                         const std::vector<double>& wl, Matrix3d& S, Matrix3d& R) const{
+    if(mode == BM_SRL){
+        Vector3d l=blendMat(L, wl);
+        S = expSym(blendMat(logS, ws));
+        R = frechetSum ? frechetSO(this->R, wr) : expSO(blendMat(logR, wr));
+        return pad(S*R, l);
+    }else if(mode == BM_SSE){
+        S = expSym(blendMat(logS, ws));
+        return pad(S,Vector3d::Zero()) * expSE(blendMat(logSE, wr));
+    }else if(mode == BM_LOG3){
+        R = blendMat(logGL, wr).exp();
+        Vector3d l=blendMat(L, wl);
+        return pad(R, l);
+    }else if(mode == BM_LOG4){
+        return blendMat(logAff, wr).exp();
+    }else if(mode == BM_SQL){
+        Vector4d q=blendQuat(quat,wr);
+        Vector3d l=blendMat(L, wl);
+        S = blendMatLin(this->S,ws);
+        Quaternion<double> Q(q);
+        R = Q.matrix().transpose();
+        return pad(S*R, l);
+    }else if(mode == BM_AFF){
+        return blendMatLin(Aff,wr);
+    }
+    return Matrix4d::Identity();
+}
 
 void BlendAff::parametrise(int mode){
     if(mode == BM_SRL || mode == BM_SSE || mode == BM_SQL){
@@ -90,13 +155,13 @@ void BlendAff::parametrise(int mode){
     }else if(mode == BM_LOG3){
         logGL.resize(num);
         for(int i=0;i<num;i++){
-            logGL[i] = Aff[i].block(0,0,3,3).log();
+            logGL[i] = logMat<Matrix3d>(Aff[i].block(0,0,3,3));
             L[i] = transPart(Aff[i]);
         }
     }else if(mode == BM_LOG4){
         logAff.resize(num);
         for(int i=0;i<num;i++){
-            logAff[i] = Aff[i].log();
+            logAff[i] = logMat(Aff[i]);
         }
     }
 }
@@ -0,0 +1,119 @@
+/**
+ * @file cacheGraph.h
+ * @brief dependency graph of cached precomputation stages
+ * @section LICENSE The MIT License
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstring>
+
+// key of the inputs of a stage, accumulated by FNV-1a
+class CacheKey {
+public:
+    unsigned long long value;
+    CacheKey(): value(14695981039346656037ULL) {};
+    CacheKey& operator<<(double x){
+        unsigned long long b;
+        std::memcpy(&b, &x, sizeof(b));
+        return mix(b);
+    }
+    CacheKey& operator<<(int x){ return mix((unsigned long long)(long long)x); }
+private:
+    CacheKey& mix(unsigned long long b){
+        for(int k=0;k<8;k++){
+            value = (value ^ (b & 0xff)) * 1099511628211ULL;
+            b >>= 8;
+        }
+        return *this;
+    }
+};
+
+// precomputation split into stages.
+// A stage has to be run when it is invalidated, when its key changes,
+// or when a stage it depends on has been run since it was last run.
+// Stages must be queried in an order compatible with the dependencies.
+class CacheGraph {
+public:
+    CacheGraph(): clock(0) {};
+    // register a stage depending on up to two earlier stages; returns its index
+    int addStage(const char* name, int dep0=-1, int dep1=-1);
+    void invalidate(int s){ stage[s].isDirty = true; }
+    void invalidateAll();
+    // whether the s-th stage with inputs of the given key has to be run
+    bool needs(int s, unsigned long long key=0);
+    // the s-th stage has been run successfully
+    void done(int s);
+    // the s-th stage has been checked and its output is unchanged; dependent stages are not rerun
+    void keep(int s);
+    // names of the stages run since clearLog()
+    const std::string& log() const { return ranStages; }
+    void clearLog(){ ranStages.clear(); }
+private:
+    struct Stage {
+        std::string name;
+        std::vector<int> deps;
+        std::vector<unsigned long> depVersion;   // versions of the dependencies when last run
+        unsigned long long key, pendingKey;
+        unsigned long version;   // 0 if never run
+        bool isDirty;
+    };
+    std::vector<Stage> stage;
+    unsigned long clock;
+    std::string ranStages;
+};
+
+int CacheGraph::addStage(const char* name, int dep0, int dep1){
+    Stage st;
+    st.name = name;
+    if(dep0 >= 0) st.deps.push_back(dep0);
+    if(dep1 >= 0) st.deps.push_back(dep1);
+    st.depVersion.assign(st.deps.size(), 0);
+    st.key = st.pendingKey = 0;
+    st.version = 0;
+    st.isDirty = true;
+    stage.push_back(st);
+    return (int)stage.size()-1;
+}
+
+void CacheGraph::invalidateAll(){
+    for(size_t s=0;s<stage.size();s++){
+        stage[s].isDirty = true;
+    }
+}
+
+bool CacheGraph::needs(int s, unsigned long long key){
+    Stage& st = stage[s];
+    st.pendingKey = key;
+    if(st.isDirty || st.version == 0 || st.key != key) return true;
+    for(size_t k=0;k<st.deps.size();k++){
+        if(stage[st.deps[k]].version != st.depVersion[k]) return true;
+    }
+    return false;
+}
+
+void CacheGraph::done(int s){
+    Stage& st = stage[s];
+    st.key = st.pendingKey;
+    st.version = ++clock;
+    for(size_t k=0;k<st.deps.size();k++){
+        st.depVersion[k] = stage[st.deps[k]].version;
+    }
+    st.isDirty = false;
+    if(!ranStages.empty()) ranStages += " ";
+    ranStages += st.name;
+}
+
+void CacheGraph::keep(int s){
+    Stage& st = stage[s];
+    st.key = st.pendingKey;
+    for(size_t k=0;k<st.deps.size();k++){
+        st.depVersion[k] = stage[st.deps[k]].version;
+    }
+    st.isDirty = false;
+}
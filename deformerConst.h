@@ -31,6 +31,22 @@
 #define WM_HARMONIC_COTAN 17
 #define WM_HARMONIC_TRANS 18
 
+// weight channel
+#define WC_ROTATION 0
+#define WC_SHEAR 1
+#define WC_TRANSLATION 2
+
+// weight storage precision
+#define WP_DOUBLE 0
+#define WP_FLOAT 1
+#define WP_FIXED16 2
+
+// weight storage
+#define WS_STORE 0
+#define WS_RECOMPUTE 1   // closed-form weights are recomputed in the blend loop
+#define STREAM_TILE_SIZE 1024   // number of points handed to a thread at once
+#define SOLVE_BLOCK_SIZE 8   // number of right hand sides solved by a thread at once
+
 // tetrahedra construction mode
 #define TM_FACE 0
 #define TM_EDGE 1
@@ -68,6 +84,35 @@
 #define VM_CONSTRAINT 3
 #define VM_STIFFNESS 4
 
+// vertex ordering
+#define VO_NONE 0
+#define VO_RCM 1
+#define VO_MORTON 2
+
+// fill-reducing ordering of the direct solvers
+#define FO_AMD 0
+#define FO_NATURAL 1
+
+// sparse solver
+#define SOLVER_LDLT 0
+#define SOLVER_LLT 1
+#define SOLVER_LU 2
+#define SOLVER_CHOLMOD 3
+#define SOLVER_CG 4
+#define SOLVER_MG 5
+#define SOLVER_CG_MG 6
+#define SOLVER_SCHWARZ 7
+
+// cache stages of the ARAP precomputation
+#define ST_TOPOLOGY 0
+#define ST_REST 1
+#define ST_DISTANCE 2
+#define ST_STIFFNESS 3
+#define ST_CONSTRAINT 4
+#define ST_FACTORISATION 5
+#define ST_WEIGHT 6
+#define ST_REDUCTION 7
+
 // error codes
 #define ERROR_ARAP_PRECOMPUTE 1
 #define INCOMPATIBLE_MESH 2
@@ -2,7 +2,7 @@
 
 #include <utility>
 #include <vector>
-#include <Eigen/Core>
+#include <Eigen/Sparse>
 
 #include "deformerConst.h"
 
@@ -10,60 +10,124 @@ using namespace Eigen;
 
 typedef SparseMatrix<double> SpMat;
 typedef Triplet<double> T;
+typedef Matrix<double, Dynamic, Dynamic, RowMajor> WeightTable;   // a row holds the weights of an element
+
+// table of distances from handles (rows) to elements (columns), held in double or float.
+// The entries live in a single aligned buffer laid out element-major: the distances of an element
+// to all the handles, which the weight loops read together, are contiguous.
+class DistTable {
+public:
+    int nRow, nCol;
+    bool isSingle;
+    DistTable(): nRow(0), nCol(0), isSingle(false) {};
+    void resize(int _nRow, int _nCol, bool _isSingle){
+        nRow = _nRow;
+        nCol = _nCol;
+        isSingle = _isSingle;
+        Index size = (Index)nRow * nCol;
+        if(isSingle){
+            f.resize(size);
+            VectorXd().swap(d);
+        }else{
+            d.resize(size);
+            VectorXf().swap(f);
+        }
+    }
+    double operator()(int i, int j) const {
+        Index k = index(i,j);
+        return isSingle ? f[k] : d[k];
+    }
+    void set(int i, int j, double v){
+        Index k = index(i,j);
+        if(isSingle){
+            f[k] = (float) v;
+        }else{
+            d[k] = v;
+        }
+    }
+    // distances of the j-th element to all the handles
+    Map<VectorXd> lineD(int j){ return Map<VectorXd>(d.data() + (Index)j*nRow, nRow); }
+    Map<VectorXf> lineF(int j){ return Map<VectorXf>(f.data() + (Index)j*nRow, nRow); }
+    size_t bytes() const { return d.size()*sizeof(double) + f.size()*sizeof(float); }
+private:
+    VectorXd d;
+    VectorXf f;
+    Index index(int i, int j) const {
+        return (Index)j*nRow + i;
+    }
+};
 
 class Distance {
     
 public:
-    std::vector< std::vector<double> > distPts, distTet;   // [i,j]-entry is the distance to the i-th handle to j-th element
+    DistTable distPts, distTet;   // (i,j)-entry is the distance to the i-th handle to j-th element
     std::vector<int> closestPts, closestTet;               // [i]-entry is the index of the closest element to i-th handle
     int nHdl, nPts, nTet;
     Distance(){};
     Distance(int _nHandle, int _nPts, int _nTet) {
         setNum(_nHandle, _nPts, _nTet);
     };
-    void setNum(int _nHandle, int _nPts, int _nTet);
-    void findClosestPts();
-    void findClosestTet();
+    void setNum(int _nHandle, int _nPts, int _nTet, bool isSingle=false);
+    void findClosestPts(const std::vector<Vector3d>& pts, const std::vector<Vector3d>& hdlPts);
+    void findClosestTet(const std::vector<Vector3d>& tetCenter, const std::vector<Vector3d>& hdlPts);
+    void findClosest(std::vector<int>& closest, const std::vector<Vector3d>& elem, const std::vector<Vector3d>& hdlPts);
     void computeCageDistPts(short cageMode, const std::vector<Vector3d>& pts, const std::vector<Vector3d>& cagePts, const std::vector<int>& cageTetList);
     void computeCageDistTet(short cageMode, const std::vector<Vector3d>& tetCenter, const std::vector<Vector3d>& cagePts, const std::vector<int>& cageTetList);
     void computeDistPts(const std::vector<Vector3d>& pts, const std::vector<Vector3d>& hdlPts);
     void computeDistTet(const std::vector<Vector3d>& tetCenter, const std::vector<Vector3d>& hdlPts);
+    void computeDist(DistTable& dist, const std::vector<Vector3d>& elem, const std::vector<Vector3d>& hdlPts);
     double distPtLin(Vector3d p,Vector3d a,Vector3d b);
     double distPtTri(Vector3d p,Vector3d a,Vector3d b,Vector3d c);
     void MVC(const std::vector<Vector3d>& pts, const std::vector<Vector3d>& cagePts,
                        const std::vector<int>& cageFaceList, std::vector< std::vector<double> >& w);
-    void normaliseWeight(short mode, std::vector<double>& w);
+    void normaliseWeight(short mode, std::vector<double>& w) const;
+    void normaliseWeight(short mode, double* w, int n) const;
+    void normaliseWeight(short mode, WeightTable& w) const;
+    void normaliseWeight(short mode, SparseMatrix<double, RowMajor>& w) const;
+};
+
+// normalises a row of n weights, to be passed to the row-wise operations of weight tables
+struct RowNormaliser {
+    const Distance& D;
+    short mode;
+    RowNormaliser(const Distance& _D, short _mode): D(_D), mode(_mode) {};
+    void operator()(double* w, int n) const { D.normaliseWeight(mode, w, n); }
 };
 
-// initialise
-void Distance::setNum(int _nHandle, int _nPts, int _nTet){
+// initialise; isSingle stores the distance tables in float
+void Distance::setNum(int _nHandle, int _nPts, int _nTet, bool isSingle){
     nHdl = _nHandle;
     nPts = _nPts;
     nTet = _nTet;
-    distPts.resize(nHdl);
-    distTet.resize(nHdl);
+    distPts.resize(nHdl, nPts, isSingle);
+    distTet.resize(nHdl, nTet, isSingle);
     closestPts.resize(nHdl);
     closestTet.resize(nHdl);
-    for(int i=0;i<nHdl;i++){
-        distPts[i].resize(nPts);
-        distTet[i].resize(nTet);
-    }
 }
 
 // distance between probe handles and mesh pts
 void Distance::computeDistPts(const std::vector<Vector3d>& pts, const std::vector<Vector3d>& hdlPts){
-    for(int i=0;i<nHdl;i++){
-        for(int j=0;j<nPts;j++){
-            distPts[i][j] = (pts[j]-hdlPts[i]).norm();
-        }
-    }
+    computeDist(distPts, pts, hdlPts);
 }
 
 // distance between probe handles and mesh tet
 void Distance::computeDistTet(const std::vector<Vector3d>& tetCenter, const std::vector<Vector3d>& hdlPts){
+    computeDist(distTet, tetCenter, hdlPts);
+}
+
+// fill a table element by element; each line is computed at once over the packed handles
+void Distance::computeDist(DistTable& dist, const std::vector<Vector3d>& elem, const std::vector<Vector3d>& hdlPts){
+    int nElem = dist.nCol;
+    Matrix3Xd H(3, nHdl);
     for(int i=0;i<nHdl;i++){
-        for(int j=0;j<nTet;j++){
-            distTet[i][j] = (tetCenter[j]-hdlPts[i]).norm();
+        H.col(i) = hdlPts[i];
+    }
+#pragma omp parallel for
+    for(int j=0;j<nElem;j++){
+        if(dist.isSingle){
+            dist.lineF(j) = (H.colwise() - elem[j]).colwise().norm().transpose().cast<float>();
+        }else{
+            dist.lineD(j) = (H.colwise() - elem[j]).colwise().norm().transpose();
         }
     }
 }
@@ -73,23 +137,25 @@ void Distance::computeCageDistPts(short cageMode, const std::vector<Vector3d>& p
     switch (cageMode){
         case TM_FACE:
         {
+#pragma omp parallel for
             for(int j=0;j<nPts;j++){
                 for(int i=0;i<nHdl;i++){
                     Vector3d a=cagePts[cageTetList[4*i]];
                     Vector3d b=cagePts[cageTetList[4*i+1]];
                     Vector3d c=cagePts[cageTetList[4*i+2]];
-                    distPts[i][j] = distPtTri(pts[j], a,b,c);
+                    distPts.set(i, j, distPtTri(pts[j], a,b,c));
                 }
             }
             break;
         }
         case TM_EDGE:
         {
+#pragma omp parallel for
             for(int j=0;j<nPts;j++){
                 for(int i=0;i<nHdl;i++){
                     Vector3d a=cagePts[cageTetList[4*i]];
                     Vector3d b=cagePts[cageTetList[4*i+1]];
-                    distPts[i][j] = distPtLin(pts[j], a,b);
+                    distPts.set(i, j, distPtLin(pts[j], a,b));
                 }
             }
             break;
@@ -97,9 +163,10 @@ void Distance::computeCageDistPts(short cageMode, const std::vector<Vector3d>& p
         case TM_VERTEX:
         case TM_VFACE:
         {
+#pragma omp parallel for
             for(int j=0;j<nPts;j++){
                 for(int i=0;i<nHdl;i++){
-                    distPts[i][j] = (pts[j]-cagePts[cageTetList[4*i]]).norm();
+                    distPts.set(i, j, (pts[j]-cagePts[cageTetList[4*i]]).norm());
                 }
             }
             break;
@@ -108,9 +175,10 @@ void Distance::computeCageDistPts(short cageMode, const std::vector<Vector3d>& p
         case CM_MLS_SIM:
         case CM_MLS_RIGID:
         {
+#pragma omp parallel for
             for(int j=0;j<nPts;j++){
                 for(int i=0;i<nHdl;i++){
-                    distPts[i][j] = (pts[j]-cagePts[i]).norm();
+                    distPts.set(i, j, (pts[j]-cagePts[i]).norm());
                 }
             }
             break;
@@ -123,23 +191,25 @@ void Distance::computeCageDistTet(short cageMode, const std::vector<Vector3d>& t
     switch (cageMode){
         case TM_FACE:
         {
+#pragma omp parallel for
             for(int j=0;j<nTet;j++){
                 for(int i=0;i<nHdl;i++){
                     Vector3d a=cagePts[cageTetList[4*i]];
                     Vector3d b=cagePts[cageTetList[4*i+1]];
                     Vector3d c=cagePts[cageTetList[4*i+2]];
-                    distTet[i][j] = distPtTri(tetCenter[j], a,b,c);
+                    distTet.set(i, j, distPtTri(tetCenter[j], a,b,c));
                 }
             }
             break;
         }
         case TM_EDGE:
         {
+#pragma omp parallel for
             for(int j=0;j<nTet;j++){
                 for(int i=0;i<nHdl;i++){
                     Vector3d a=cagePts[cageTetList[4*i]];
                     Vector3d b=cagePts[cageTetList[4*i+1]];
-                    distTet[i][j] = distPtLin(tetCenter[j], a,b);
+                    distTet.set(i, j, distPtLin(tetCenter[j], a,b));
                 }
             }
             break;
@@ -147,9 +217,10 @@ void Distance::computeCageDistTet(short cageMode, const std::vector<Vector3d>& t
         case TM_VERTEX:
         case TM_VFACE:
         {
+#pragma omp parallel for
             for(int j=0;j<nTet;j++){
                 for(int i=0;i<nHdl;i++){
-                    distTet[i][j] = (tetCenter[j]-cagePts[cageTetList[4*i]]).norm();
+                    distTet.set(i, j, (tetCenter[j]-cagePts[cageTetList[4*i]]).norm());
                 }
             }
             break;
@@ -158,9 +229,10 @@ void Distance::computeCageDistTet(short cageMode, const std::vector<Vector3d>& t
         case CM_MLS_SIM:
         case CM_MLS_RIGID:
         {
+#pragma omp parallel for
             for(int j=0;j<nTet;j++){
                 for(int i=0;i<nHdl;i++){
-                    distTet[i][j] = (tetCenter[j]-cagePts[i]).norm();
+                    distTet.set(i, j, (tetCenter[j]-cagePts[i]).norm());
                 }
             }
             break;
@@ -170,29 +242,31 @@ void Distance::computeCageDistTet(short cageMode, const std::vector<Vector3d>& t
 
 
 // find closest point on mesh from each handle
-void Distance::findClosestPts(){
-    for(int i=0;i<nHdl;i++){
-        closestPts[i] = 0;
-        double min_d = HUGE_VAL;
-        for(int j=0;j<nPts;j++){
-            if( distPts[i][j] < min_d){
-                min_d = distPts[i][j];
-                closestPts[i] = j;
-            }
-        }
-    }
+void Distance::findClosestPts(const std::vector<Vector3d>& pts, const std::vector<Vector3d>& hdlPts){
+    findClosest(closestPts, pts, hdlPts);
 }
 // find closest tet on mesh from each handle
-void Distance::findClosestTet(){
+void Distance::findClosestTet(const std::vector<Vector3d>& tetCenter, const std::vector<Vector3d>& hdlPts){
+    findClosest(closestTet, tetCenter, hdlPts);
+}
+
+// the closest element to each handle, probe by probe over the packed coordinates.
+// Only comparisons are needed, so the squared distances are used and the table is not read.
+void Distance::findClosest(std::vector<int>& closest, const std::vector<Vector3d>& elem, const std::vector<Vector3d>& hdlPts){
+    int nElem = (int) elem.size();
+    if(nElem == 0){
+        std::fill(closest.begin(), closest.end(), 0);
+        return;
+    }
+    Matrix3Xd P(3, nElem);
+    for(int j=0;j<nElem;j++){
+        P.col(j) = elem[j];
+    }
+#pragma omp parallel for
     for(int i=0;i<nHdl;i++){
-        closestTet[i] = 0;
-        double min_d = HUGE_VAL;
-        for(int j=0;j<nTet;j++){
-            if( distTet[i][j] < min_d){
-                min_d = distTet[i][j];
-                closestTet[i] = j;
-            }
-        }
+        Index j;
+        (P.colwise() - hdlPts[i]).colwise().squaredNorm().minCoeff(&j);
+        closest[i] = (int) j;
     }
 }
 
@@ -271,21 +345,42 @@ void Distance::MVC(const std::vector<Vector3d>& pts, const std::vector<Vector3d>
 }
 
 // normalise weights
-void Distance::normaliseWeight(short mode, std::vector<double>& w){
+void Distance::normaliseWeight(short mode, std::vector<double>& w) const{
+    normaliseWeight(mode, w.data(), (int) w.size());
+}
+
+// normalise n weights in place; softmax is shifted by the maximum to avoid overflow
+void Distance::normaliseWeight(short mode, double* w, int n) const{
+    if(n == 0) return;
+    Map<ArrayXd> a(w, n);
     if(mode == NM_NONE || mode == NM_LINEAR){
-        double sum = std::accumulate(w.begin(), w.end(), 0.0);
+        double sum = a.sum();
         if ((sum > 1 || mode == NM_LINEAR) && sum != 0.0){
-            for (int i = 0; i < w.size(); i++){
-                w[i] /= sum;
-            }
+            a /= sum;
         }
     }else if(mode == NM_SOFTMAX){
-        double sum = 0.0;
-        for (int i = 0; i < w.size(); i++){
-            sum += exp(w[i]);
-        }
-        for (int i = 0; i < w.size(); i++){
-            w[i] = exp(w[i])/sum;
-        }
+        a = (a - a.maxCoeff()).exp();
+        a /= a.sum();
+    }
+}
+
+// normalise every row of a weight table
+void Distance::normaliseWeight(short mode, WeightTable& w) const{
+    int numRow = (int) w.rows(), numCol = (int) w.cols();
+#pragma omp parallel for
+    for(int j=0;j<numRow;j++){
+        normaliseWeight(mode, w.data() + (Index)j*numCol, numCol);
+    }
+}
+
+// normalise every row of a sparse weight table; only the stored entries take part,
+// so softmax leaves the absent ones zero
+void Distance::normaliseWeight(short mode, SparseMatrix<double, RowMajor>& w) const{
+    w.makeCompressed();
+    int numRow = (int) w.outerSize();
+#pragma omp parallel for
+    for(int j=0;j<numRow;j++){
+        int start = w.outerIndexPtr()[j];
+        normaliseWeight(mode, w.valuePtr() + start, w.outerIndexPtr()[j+1] - start);
     }
 }
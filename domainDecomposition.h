@@ -0,0 +1,262 @@
+/**
+ * @file domainDecomposition.h
+ * @brief additive Schwarz preconditioner over a partition of the unknowns
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <Eigen/Sparse>
+#include <Eigen/Dense>
+
+#include "multigrid.h"   // MatrixFreeOperator
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Eigen;
+
+// two level additive Schwarz for a symmetric positive definite matrix.
+// The graph of the matrix (for ARAP, the vertices sharing a tet) is cut into subdomains by
+// recursive bisection along breadth first orderings, and each subdomain is extended by a few layers
+// of neighbours. The subdomain matrices are factorised independently and solved in parallel;
+// the coarse level has one unknown per subdomain (constant on the owned unknowns).
+class SchwarzPreconditioner {
+public:
+    int numDomain;   // 0 for two per thread
+    int overlap;   // layers of neighbours added to each subdomain
+    // buffers of the preconditioner, kept by the caller so that repeated solves do not allocate
+    struct Workspace {
+        MatrixXd stacked, rc, zc;
+        std::vector<MatrixXd> local, work;   // for each subdomain
+    };
+    SchwarzPreconditioner(): numDomain(0), overlap(2), op(0) {};
+    // returns false on failure
+    bool compute(const SpMat& A, const MatrixFreeOperator* op=0);
+    // y = A x
+    void multiply(const MatrixXd& x, MatrixXd& y) const;
+    // z = M^{-1} r
+    void precondition(const MatrixXd& r, MatrixXd& z, Workspace& w) const;
+    size_t bytes() const;
+private:
+    SpMatRow mat;   // empty if matrix free
+    std::vector<int> owner;   // subdomain owning each unknown
+    std::vector< std::vector<int> > domain;   // sorted unknowns of each subdomain including the overlap
+    std::vector<int> localOffset;   // rows of each subdomain in the stacked local solutions
+    std::vector< std::unique_ptr< SimplicialLDLTDiag<SpMat> > > factor;
+    SpMatRow gather;   // sums the stacked local solutions into the unknowns
+    LDLT<MatrixXd> coarse;
+    const MatrixFreeOperator* op;
+    void bisect(const SpMatRow& A, const std::vector<int>& nodes, int first, int numPart,
+                std::vector<int>& stamp, std::vector<int>& seen, int& clock);
+};
+
+// split nodes into numPart parts numbered from first
+void SchwarzPreconditioner::bisect(const SpMatRow& A, const std::vector<int>& nodes, int first, int numPart,
+                                   std::vector<int>& stamp, std::vector<int>& seen, int& clock){
+    if(numPart == 1){
+        for(size_t k=0;k<nodes.size();k++){
+            owner[nodes[k]] = first;
+        }
+        return;
+    }
+    int member = ++clock;
+    for(size_t k=0;k<nodes.size();k++){
+        stamp[nodes[k]] = member;
+    }
+    // breadth first order within the nodes; the second sweep starts from the last node of the first
+    std::vector<int> order;
+    int start = nodes[0];
+    for(int sweep=0;sweep<2;sweep++){
+        int visit = ++clock;
+        order.clear();
+        size_t next = 0, head = 0;
+        int root = start;
+        while(order.size() < nodes.size()){
+            // another connected component starts from the first unvisited node
+            while(seen[root] == visit){
+                root = nodes[next++];
+            }
+            seen[root] = visit;
+            order.push_back(root);
+            for(;head<order.size();head++){
+                for(SpMatRow::InnerIterator it(A,order[head]); it; ++it){
+                    int w = (int)it.col();
+                    if(stamp[w] == member && seen[w] != visit){
+                        seen[w] = visit;
+                        order.push_back(w);
+                    }
+                }
+            }
+        }
+        start = order.back();
+    }
+    int leftPart = numPart/2;
+    size_t split = nodes.size() * leftPart / numPart;
+    std::vector<int> left(order.begin(), order.begin()+split), right(order.begin()+split, order.end());
+    std::vector<int>().swap(order);
+    bisect(A, left, first, leftPart, stamp, seen, clock);
+    bisect(A, right, first+leftPart, numPart-leftPart, stamp, seen, clock);
+}
+
+bool SchwarzPreconditioner::compute(const SpMat& A, const MatrixFreeOperator* _op){
+    op = _op;
+    SpMatRow M = A;
+    int n = (int)M.rows();
+    int numPart = numDomain;
+    if(numPart <= 0){
+#ifdef _OPENMP
+        numPart = 2*omp_get_max_threads();
+#else
+        numPart = 2;
+#endif
+    }
+    numPart = std::max(1, std::min(numPart, n/1000));
+    // partition
+    owner.assign(n, 0);
+    std::vector<int> nodes(n), stamp(n, 0), seen(n, 0);
+    for(int i=0;i<n;i++){
+        nodes[i] = i;
+    }
+    int clock = 0;
+    bisect(M, nodes, 0, numPart, stamp, seen, clock);
+    // subdomains with the overlap
+    domain.assign(numPart, std::vector<int>());
+    for(int i=0;i<n;i++){
+        domain[owner[i]].push_back(i);
+    }
+    std::fill(stamp.begin(), stamp.end(), -1);
+    for(int s=0;s<numPart;s++){
+        std::vector<int>& d = domain[s];
+        for(size_t k=0;k<d.size();k++){
+            stamp[d[k]] = s;
+        }
+        size_t layerStart = 0;
+        for(int l=0;l<overlap;l++){
+            size_t layerEnd = d.size();
+            for(size_t k=layerStart;k<layerEnd;k++){
+                for(SpMatRow::InnerIterator it(M,d[k]); it; ++it){
+                    int w = (int)it.col();
+                    if(stamp[w] != s){
+                        stamp[w] = s;
+                        d.push_back(w);
+                    }
+                }
+            }
+            layerStart = layerEnd;
+        }
+        std::sort(d.begin(), d.end());
+    }
+    localOffset.assign(numPart+1, 0);
+    for(int s=0;s<numPart;s++){
+        localOffset[s+1] = localOffset[s] + (int)domain[s].size();
+    }
+    // factorise the subdomain matrices
+    factor.resize(numPart);
+    bool isOk = true;
+#pragma omp parallel for schedule(dynamic)
+    for(int s=0;s<numPart;s++){
+        const std::vector<int>& d = domain[s];
+        std::vector< Triplet<double> > triplet;
+        for(size_t k=0;k<d.size();k++){
+            for(SpMatRow::InnerIterator it(M,d[k]); it; ++it){
+                std::vector<int>::const_iterator c = std::lower_bound(d.begin(), d.end(), (int)it.col());
+                if(c != d.end() && *c == it.col()){
+                    triplet.push_back(Triplet<double>((int)k, (int)(c-d.begin()), it.value()));
+                }
+            }
+        }
+        SpMat local((int)d.size(), (int)d.size());
+        local.setFromTriplets(triplet.begin(), triplet.end());
+        factor[s].reset(new SimplicialLDLTDiag<SpMat>);
+        factor[s]->compute(local);
+        if(factor[s]->info() != Success){
+#pragma omp critical
+            isOk = false;
+        }
+    }
+    if(!isOk) return false;
+    std::vector< Triplet<double> > triplet;
+    triplet.reserve(localOffset[numPart]);
+    for(int s=0;s<numPart;s++){
+        for(size_t k=0;k<domain[s].size();k++){
+            triplet.push_back(Triplet<double>(domain[s][k], localOffset[s]+(int)k, 1.0));
+        }
+    }
+    gather.resize(n, localOffset[numPart]);
+    gather.setFromTriplets(triplet.begin(), triplet.end());
+    // coarse matrix Z^T A Z with Z the indicators of the owned unknowns
+    MatrixXd E = MatrixXd::Zero(numPart, numPart);
+    for(int i=0;i<n;i++){
+        for(SpMatRow::InnerIterator it(M,i); it; ++it){
+            E(owner[i], owner[it.col()]) += it.value();
+        }
+    }
+    coarse.compute(E);
+    if(coarse.info() != Success) return false;
+    if(op){
+        mat = SpMatRow();
+    }else{
+        mat.swap(M);
+    }
+    return true;
+}
+
+void SchwarzPreconditioner::multiply(const MatrixXd& x, MatrixXd& y) const{
+    if(op){
+        op->multiply(x, y);
+    }else{
+        y.noalias() = mat * x;
+    }
+}
+
+void SchwarzPreconditioner::precondition(const MatrixXd& r, MatrixXd& z, Workspace& w) const{
+    int numPart = (int)domain.size();
+    int cols = (int)r.cols();
+    if((int)w.local.size() != numPart){
+        w.local.resize(numPart);
+        w.work.resize(numPart);
+    }
+    w.stacked.resize(localOffset[numPart], cols);
+#pragma omp parallel for schedule(dynamic)
+    for(int s=0;s<numPart;s++){
+        const std::vector<int>& d = domain[s];
+        MatrixXd& local = w.local[s];
+        local.resize(d.size(), cols);
+        for(size_t k=0;k<d.size();k++){
+            local.row(k) = r.row(d[k]);
+        }
+        choleskySolve(*factor[s], local, local, w.work[s]);
+        w.stacked.middleRows(localOffset[s], d.size()) = local;
+    }
+    z.noalias() = gather * w.stacked;
+    // coarse correction
+    w.rc.setZero(numPart, cols);
+    for(int i=0;i<(int)owner.size();i++){
+        w.rc.row(owner[i]) += r.row(i);
+    }
+    w.zc = coarse.solve(w.rc);
+#pragma omp parallel for
+    for(int i=0;i<(int)owner.size();i++){
+        z.row(i) += w.zc.row(owner[i]);
+    }
+}
+
+size_t SchwarzPreconditioner::bytes() const{
+    size_t s = (size_t)mat.nonZeros() * (sizeof(double) + sizeof(int)) + (size_t)(mat.outerSize()+1) * sizeof(int);
+    s += (size_t)gather.nonZeros() * (sizeof(double) + sizeof(int)) + (size_t)(gather.outerSize()+1) * sizeof(int);
+    for(size_t k=0;k<factor.size();k++){
+        const SpMat& L = factor[k]->matrixL().nestedExpression();
+        s += (size_t)L.nonZeros() * (sizeof(double) + sizeof(int)) + (size_t)(L.outerSize()+1) * sizeof(int);
+        s += domain[k].size() * (sizeof(double) + sizeof(int));
+    }
+    return s + owner.size() * sizeof(int);
+}
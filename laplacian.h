@@ -11,27 +11,21 @@
 #pragma once
 
 #include <utility>
+#include <memory>
 #include <Eigen/Sparse>
 
 #include "deformerConst.h"
+#include "sparseSolver.h"
+#include "tetrise.h"
 
-//#define _SuiteSparse
 //#define _CERES
 
 using namespace Eigen;
 
 typedef SparseMatrix<double> SpMat;
+typedef SparseMatrix<double, RowMajor> SpMatRow;
 typedef Triplet<double> T;
 
-#ifdef _SuiteSparse
-#include <Eigen/CholmodSupport>
-typedef CholmodDecomposition<SpMat> SpSolver;
-#else
-typedef SimplicialLDLT<SpMat> SpSolver;
-//typedef SimplicialLLT<SpMat> SpSolver;
-//typedef SparseLU<SpMat> SpSolver;
-#endif
-
 #ifdef _CERES
 #include "ceres/ceres.h"
 #include "glog/logging.h"
@@ -39,132 +33,358 @@ typedef SimplicialLDLT<SpMat> SpSolver;
 
 
 
-class Laplacian {
+// sparse matrix assembled out of dense element blocks.
+// The sparsity pattern is computed once from the element indices, and every entry of every block
+// is given the slot of the compressed storage it is summed into, so that the values are gathered
+// in parallel directly into the matrix. The diagonal is always in the pattern.
+class PatternAssembler {
+public:
+    SpMat mat;
+    std::vector<double> value;   // entry (j,k) of the i-th block is value[(i*blockSize+k)*blockSize+j]
+    PatternAssembler(): dim(0), numElem(0), blockSize(0), stride(0) {};
+    // the i-th block couples index[stride*i] ... index[stride*i+blockSize-1]; returns true if the pattern is rebuilt
+    bool setPattern(int dim, int numElem, int blockSize, const std::vector<int>& index, int stride);
+    // sum the block entries into mat
+    void assemble();
+    void addDiagonal(int i, double v){ mat.valuePtr()[diagSlot[i]] += v; }
+private:
+    int dim, numElem, blockSize, stride;
+    std::vector<int> index;   // kept to detect a change of the pattern
+    std::vector<int> entryOffset, entry;   // block entries summed into each slot
+    std::vector<int> diagSlot;
+};
+
+bool PatternAssembler::setPattern(int _dim, int _numElem, int _blockSize, const std::vector<int>& _index, int _stride){
+    if(_dim == dim && _numElem == numElem && _blockSize == blockSize && _stride == stride && _index == index){
+        return false;
+    }
+    dim = _dim;
+    numElem = _numElem;
+    blockSize = _blockSize;
+    stride = _stride;
+    index = _index;
+    int blockEntries = blockSize*blockSize;
+    int numEntry = numElem*blockEntries;
+    value.resize(numEntry);
+    // sort the entries column major; the diagonal entries come last
+    int bits = Tetrise::bitWidth(dim);
+    std::vector<unsigned long long> key(numEntry+dim);
+    std::vector<int> id(numEntry+dim);
+#pragma omp parallel for
+    for(int i=0;i<numElem;i++){
+        for(int k=0;k<blockSize;k++){
+            for(int j=0;j<blockSize;j++){
+                int e = i*blockEntries + k*blockSize + j;
+                key[e] = ((unsigned long long)index[stride*i+k] << bits) | (unsigned long long)index[stride*i+j];
+                id[e] = e;
+            }
+        }
+    }
+    for(int i=0;i<dim;i++){
+        key[numEntry+i] = ((unsigned long long)i << bits) | (unsigned long long)i;
+        id[numEntry+i] = numEntry+i;
+    }
+    Tetrise::radixSort(key, id, 2*bits);
+    // a slot for each distinct key
+    int numSlot = 0;
+    for(size_t k=0;k<key.size();k++){
+        if(k==0 || key[k] != key[k-1]) numSlot++;
+    }
+    mat.resize(dim, dim);
+    mat.resizeNonZeros(numSlot);
+    int* outer = mat.outerIndexPtr();
+    int* inner = mat.innerIndexPtr();
+    std::fill(outer, outer+dim+1, 0);
+    entryOffset.assign(numSlot+1, 0);
+    entry.resize(numEntry);
+    diagSlot.resize(dim);
+    unsigned long long mask = (1ULL << bits) - 1;
+    int slot = -1, cur = 0;
+    for(size_t k=0;k<key.size();k++){
+        if(k==0 || key[k] != key[k-1]){
+            slot++;
+            inner[slot] = (int)(key[k] & mask);
+            outer[(key[k] >> bits)+1]++;
+            entryOffset[slot] = cur;
+        }
+        if(id[k] < numEntry){
+            entry[cur++] = id[k];
+        }else{
+            diagSlot[id[k]-numEntry] = slot;
+        }
+    }
+    entryOffset[numSlot] = cur;
+    for(int c=0;c<dim;c++){
+        outer[c+1] += outer[c];
+    }
+    return true;
+}
+
+void PatternAssembler::assemble(){
+    double* val = mat.valuePtr();
+    int numSlot = (int)mat.nonZeros();
+#pragma omp parallel for
+    for(int s=0;s<numSlot;s++){
+        double sum = 0.0;
+        for(int k=entryOffset[s];k<entryOffset[s+1];k++){
+            sum += value[entry[k]];
+        }
+        val[s] = sum;
+    }
+}
+
+
+// The system matrix of ARAP can also be applied tet by tet without being assembled,
+// for the solvers which work matrix free.
+class Laplacian : public MatrixFreeOperator {
 public:
     int numTet;  // the number of tetrahedra
     int dim;   // the dimension of the system including ghost vertices
     double transWeight;
-    SpSolver solver;
+    short solverType, fillOrdering;
+    bool isMixed;   // single precision factorisation with refinement
+    bool isMatrixFree;   // the ARAP matrix is not kept once the solver is set up
+    std::unique_ptr<SparseSolver> solver;
     SpMat constraintMat;
-    SpMat laplacian;
+    PatternAssembler assembler;   // system matrix (ARAP) or laplacian (cotan)
+    std::vector<T> constraintTriplet;   // reused across rebuilds
     std::vector<int> tetList;
     std::vector<Matrix4d> tetMatrix,tetMatrixInverse;
     std::vector<double> tetWeight;
     std::vector< std::pair<int,double> > constraintWeight;  //  [i,w] = i-th vertex is constrained with weight w
+    VectorXd penalty;   // diagonal of the soft constraints
     MatrixXd constraintVal;       // i-th row = value of i-th constraint
     MatrixXd Sol;
-    Laplacian(): numTet(0), tetMatrix(0), tetMatrixInverse(0), tetWeight(0), constraintWeight(0), transWeight(0) {
+    MatrixXd rhs;      // right hand side kept to avoid reallocation
+    SpMatRow rhsOperator;   // maps the packed target matrices to the right hand side
+    SpMatRow constraintOperator;   // numTet * constraintMat, mapping constraintVal to the right hand side
+    MatrixXd packedTarget;   // row 4i+m = m-th row (without the last column) of the target matrix of the i-th tet
+    mutable MatrixXd packed;   // tetMatrixInverse_i * x_i stacked by multiply()
+    Laplacian(): numTet(0), dim(0), transWeight(0), solverType(SOLVER_LDLT), fillOrdering(FO_AMD),
+        isMixed(false), isMatrixFree(false), solver(createSparseSolver(SOLVER_LDLT)),
+        tetMatrix(0), tetMatrixInverse(0), tetWeight(0), constraintWeight(0) {
     };
+    void setSolver(short type, short ordering=FO_AMD, bool mixed=false, bool matrixFree=false);
+    // y = (the ARAP matrix) x
+    void multiply(const MatrixXd& x, MatrixXd& y) const;
     int ARAPprecompute();
     void ARAPSolve(const std::vector<Matrix4d>& targetMat);
     void harmonicSolve();
+    template<class Store>
+    void harmonicSolve(Store& store, int blockSize=SOLVE_BLOCK_SIZE);
     int cotanPrecompute();
     void computeTetMatrixInverse();
+private:
+    void makeConstraintMatrix();
+    void makeRhsOperator();
 };
 
 
-// construct the system of ARAP with soft constraints
-int Laplacian::ARAPprecompute(){
-    std::vector<T> tripletListMat(0);
-    tripletListMat.reserve(numTet*16);
-    Matrix4d Hlist;
-    Matrix4d diag=Matrix4d::Identity();
-    diag(3,3)=transWeight;
+// select the solver backend (SOLVER_*), its fill-reducing ordering (FO_*), precision and
+// whether ARAP is solved matrix free (if the solver supports it);
+// the factorisation has to be recomputed after a change
+void Laplacian::setSolver(short type, short ordering, bool mixed, bool matrixFree){
+    if(type == solverType && ordering == fillOrdering && mixed == isMixed && matrixFree == isMatrixFree) return;
+    solverType = type;
+    fillOrdering = ordering;
+    isMixed = mixed;
+    solver.reset(createSparseSolver(type, ordering, mixed));
+    isMatrixFree = matrixFree && solver->setOperator(this);
+}
+
+// the product with the tets: (the ARAP matrix) x = rhsOperator * (tetMatrixInverse_i * x_i) + penalty x,
+// where x_i are the rows of x at the vertices of the i-th tet. The products are stacked in a member,
+// so multiply() is not to be called from several threads at once.
+void Laplacian::multiply(const MatrixXd& x, MatrixXd& y) const{
+    if(!isMatrixFree){
+        y.noalias() = assembler.mat * x;
+        return;
+    }
+    int cols = (int)x.cols();
+    packed.resize(4*numTet, cols);
+#pragma omp parallel for
     for(int i=0;i<numTet;i++){
-        Hlist=tetWeight[i] * tetMatrixInverse[i].transpose() * diag * tetMatrixInverse[i];
-        for(int j=0;j<4;j++){
-            for(int k=0;k<4;k++){
-                tripletListMat.push_back(T(tetList[4*i+j],tetList[4*i+k],Hlist(j,k)));
+        // three columns at a time on the stack
+        for(int c=0;c<cols;c+=3){
+            int width = std::min(3, cols-c);
+            Matrix<double,4,Dynamic,0,4,3> corner(4, width);
+            for(int m=0;m<4;m++){
+                corner.row(m) = x.block(tetList[4*i+m], c, 1, width);
             }
+            packed.block(4*i, c, 4, width).noalias() = tetMatrixInverse[i] * corner;
         }
     }
-    SpMat mat(dim,dim);
-    mat.setFromTriplets(tripletListMat.begin(), tripletListMat.end());
-    // set soft constraint
+    y.noalias() = rhsOperator * packed;
+    y.noalias() += penalty.asDiagonal() * x;
+}
+
+// matrix distributing the soft constraints to vertices
+void Laplacian::makeConstraintMatrix(){
     int numConstraints = constraintWeight.size();
-    std::vector<T> tripletListF(0),tripletListC(0);
+    constraintTriplet.clear();
     for(int i=0;i<numConstraints;i++){
-        tripletListC.push_back(T( constraintWeight[i].first, i, constraintWeight[i].second));
-        tripletListF.push_back(T( i, constraintWeight[i].first, 1));
+        constraintTriplet.push_back(T( constraintWeight[i].first, i, constraintWeight[i].second));
     }
     constraintMat.resize(dim,numConstraints);
     constraintMat.setZero();
-    constraintMat.setFromTriplets(tripletListC.begin(), tripletListC.end());
-    SpMat F(numConstraints,dim);
-    F.setFromTriplets(tripletListF.begin(), tripletListF.end());
-    // mat = (L^T,C_M)*(L \\ C_F),   C_M = constraintWeight * C_F^T
-    mat += numTet * constraintMat * F;
-    solver.compute(mat);
-    if(solver.info() != Success){
+    constraintMat.setFromTriplets(constraintTriplet.begin(), constraintTriplet.end());
+    constraintOperator = numTet * constraintMat;
+}
+
+// the right hand side of ARAP is linear in the target matrices:
+// rhs(tetList[4i+j],k) = sum_m K_i(j,m) target_i(m,k) with K_i = tetWeight[i] * tetMatrixInverse[i]^T * diag(1,1,1,transWeight).
+// It is stored as a row major sparse matrix acting on the packed targets, so that the rows are computed in parallel.
+void Laplacian::makeRhsOperator(){
+    // tets around each vertex
+    std::vector<int> pairs(8*numTet);
+    for(int h=0;h<4*numTet;h++){
+        pairs[2*h] = tetList[h];
+        pairs[2*h+1] = h;
+    }
+    std::vector<int> offset, corner;
+    Tetrise::makeCompressedRows(dim, pairs, offset, corner);
+    rhsOperator.resize(dim, 4*numTet);
+    rhsOperator.resizeNonZeros(16*numTet);
+    int* outer = rhsOperator.outerIndexPtr();
+    int* inner = rhsOperator.innerIndexPtr();
+    double* val = rhsOperator.valuePtr();
+    for(int v=0;v<=dim;v++){
+        outer[v] = 4*offset[v];
+    }
+    Matrix4d diag=Matrix4d::Identity();
+    diag(3,3)=transWeight;
+#pragma omp parallel for
+    for(int c=0;c<4*numTet;c++){
+        int i = corner[c]/4, j = corner[c]%4;
+        RowVector4d K = tetWeight[i] * (tetMatrixInverse[i].transpose() * diag).row(j);
+        for(int m=0;m<4;m++){
+            inner[4*c+m] = 4*i+m;
+            val[4*c+m] = K[m];
+        }
+    }
+}
+
+// construct the system of ARAP with soft constraints
+int Laplacian::ARAPprecompute(){
+    assembler.setPattern(dim, numTet, 4, tetList, 4);
+    std::vector<double>& value = assembler.value;
+    Matrix4d diag=Matrix4d::Identity();
+    diag(3,3)=transWeight;
+#pragma omp parallel for
+    for(int i=0;i<numTet;i++){
+        Map<Matrix4d> H(&value[16*i]);
+        H = tetWeight[i] * tetMatrixInverse[i].transpose() * diag * tetMatrixInverse[i];
+    }
+    assembler.assemble();
+    // set soft constraint
+    // mat = (L^T,C_M)*(L \\ C_F),   C_M = constraintWeight * C_F^T, whose constraint part is diagonal
+    makeConstraintMatrix();
+    penalty = VectorXd::Zero(dim);
+    for(size_t i=0;i<constraintWeight.size();i++){
+        penalty[constraintWeight[i].first] += numTet * constraintWeight[i].second;
+        assembler.addDiagonal(constraintWeight[i].first, numTet * constraintWeight[i].second);
+    }
+    makeRhsOperator();
+    if(!solver->compute(assembler.mat)){
         //std::string error_mes = solver.lastErrorMessage();
         MGlobal::displayInfo("Cleanup the mesh first: Mesh menu => Cleanup => Remove zero edges, faces");
         return ERROR_ARAP_PRECOMPUTE;
     }
+    // the solver applies the matrix through multiply()
+    if(isMatrixFree){
+        assembler = PatternAssembler();
+    }
     return 0;
 }
 
 // solve the ARAP system
 void Laplacian::ARAPSolve(const std::vector<Matrix4d>& targetMat){
-    Matrix4d Glist;
-    Matrix4d diag=Matrix4d::Identity();
-    diag(3,3)=transWeight;
-    MatrixXd G = MatrixXd::Zero(dim,3);
+    packedTarget.resize(4*numTet, 3);
+#pragma omp parallel for
     for(int i=0;i<numTet;i++){
-        Glist= tetWeight[i] * tetMatrixInverse[i].transpose() * diag * targetMat[i];
-        for(int k=0;k<3;k++){
-            for(int j=0;j<4;j++){
-                G(tetList[4*i+j],k) += Glist(j,k);
-            }
-        }
+        packedTarget.block<4,3>(4*i,0) = targetMat[i].leftCols<3>();
     }
+    rhs.noalias() = rhsOperator * packedTarget;
     // set soft constraint
     // (H^T,C_M) * (G \\ constraintVal)
-    G += numTet * constraintMat * constraintVal;
-    Sol = solver.solve(G);
+    rhs.noalias() += constraintOperator * constraintVal;
+    solver->resetResidual();
+    solver->solve(rhs, Sol);
+}
+
+// harmonic weighting.
+// The right hand sides are built sparsely, as each probe touches only its own constraints,
+// and solved in parallel blocks of columns. Each block of solutions (dim x columns) is handed to
+// store(first column, block), so that the dense solution of all the probes is never formed.
+template<class Store>
+void Laplacian::harmonicSolve(Store& store, int blockSize){
+    SpMat G = constraintOperator * constraintVal.sparseView();
+    int numCol = (int)G.cols();
+    int numBlock = (numCol + blockSize - 1) / blockSize;
+    bool isParallel = solver->isThreadSafe();
+    solver->resetResidual();
+#pragma omp parallel for schedule(dynamic) if(isParallel)
+    for(int b=0;b<numBlock;b++){
+        int first = b*blockSize;
+        int cols = std::min(blockSize, numCol-first);
+        MatrixXd rhsBlock(G.middleCols(first, cols));
+        MatrixXd X;
+        solver->solve(rhsBlock, X);
+        store(first, X);
+    }
 }
 
-// harmonic weighting
+// stores blocks of solutions into the columns of a matrix
+struct ColumnStore {
+    MatrixXd& mat;
+    ColumnStore(MatrixXd& _mat): mat(_mat) {};
+    void operator()(int first, const MatrixXd& X){
+        mat.middleCols(first, X.cols()) = X;
+    }
+};
+
+// harmonic weighting into Sol
 void Laplacian::harmonicSolve(){
-    MatrixXd G = numTet * constraintMat * constraintVal;
-    Sol = solver.solve(G);
+    Sol.resize(dim, constraintVal.cols());
+    ColumnStore store(Sol);
+    harmonicSolve(store);
 }
 
 // harmonic weighting with cotan laplacian
 int Laplacian::cotanPrecompute(){
-    std::vector<T> tripletListMat(0);
-    tripletListMat.reserve(numTet*9);
+    // the product by tets is that of ARAP
+    if(isMatrixFree){
+        setSolver(solverType, fillOrdering, isMixed, false);
+    }
+    assembler.setPattern(dim, numTet, 3, tetList, 4);
+    std::vector<double>& value = assembler.value;
+#pragma omp parallel for
     for(int i=0;i<numTet;i++){
-        std::vector<Vector3d> l(3);
+        Vector3d l[3];
         l[0] << tetMatrix[i](2,0)-tetMatrix[i](1,0), tetMatrix[i](2,1)-tetMatrix[i](1,1), tetMatrix[i](2,2)-tetMatrix[i](1,2);
         l[1] << tetMatrix[i](0,0)-tetMatrix[i](2,0), tetMatrix[i](0,1)-tetMatrix[i](2,1), tetMatrix[i](0,2)-tetMatrix[i](2,2);
         l[2] << tetMatrix[i](1,0)-tetMatrix[i](0,0), tetMatrix[i](1,1)-tetMatrix[i](0,1), tetMatrix[i](1,2)-tetMatrix[i](0,2);
         double w = tetWeight[i]/(l[1].cross(l[2]).norm());
+        Map<Matrix3d> block(&value[9*i]);
         for(int j=0;j<3;j++){
             int j1=(j+1) % 3;
             int j2=(j+2) % 3;
-            tripletListMat.push_back(T(tetList[4*i+j],tetList[4*i+j],   w*l[j].dot(l[j1]+l[j2])));
-            tripletListMat.push_back(T(tetList[4*i+j],tetList[4*i+j1], -w*l[j].dot(l[j1])));
-            tripletListMat.push_back(T(tetList[4*i+j],tetList[4*i+j2], -w*l[j].dot(l[j2])));
+            block(j,j) = w*l[j].dot(l[j1]+l[j2]);
+            block(j,j1) = -w*l[j].dot(l[j1]);
+            block(j,j2) = -w*l[j].dot(l[j2]);
         }
     }
-    laplacian.resize(dim, dim);
-    laplacian.setZero();
-    laplacian.setFromTriplets(tripletListMat.begin(), tripletListMat.end());
+    assembler.assemble();
+    const SpMat& laplacian = assembler.mat;
     // set soft constraint
-    int numConstraints = constraintWeight.size();
-    std::vector<T> tripletListF(0),tripletListC(0);
-    for(int i=0;i<numConstraints;i++){
-        tripletListC.push_back(T( constraintWeight[i].first, i, constraintWeight[i].second));
-        tripletListF.push_back(T( i, constraintWeight[i].first, 1));
+    makeConstraintMatrix();
+    VectorXd penalty = VectorXd::Zero(dim);
+    for(size_t i=0;i<constraintWeight.size();i++){
+        penalty[constraintWeight[i].first] += numTet * constraintWeight[i].second;
     }
-    constraintMat.resize(dim,numConstraints);
-    constraintMat.setZero();
-    constraintMat.setFromTriplets(tripletListC.begin(), tripletListC.end());
-    SpMat F(numConstraints,dim);
-    F.setFromTriplets(tripletListF.begin(), tripletListF.end());
-    SpMat mat = laplacian.transpose() * laplacian + numTet * constraintMat * F;
-    solver.compute(mat);
-    if(solver.info() != Success){
+    SpMat mat = laplacian.transpose() * laplacian;
+    mat += SpMat(penalty.asDiagonal());
+    if(!solver->compute(mat)){
         //std::string error_mes = solver.lastErrorMessage();
         MGlobal::displayInfo("Cleanup the mesh first: Mesh menu => Cleanup => Remove zero edges, faces");
         return ERROR_ARAP_PRECOMPUTE;
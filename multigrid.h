@@ -0,0 +1,287 @@
+/**
+ * @file multigrid.h
+ * @brief smoothed aggregation multigrid
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#pragma once
+
+#include <vector>
+#include <random>
+#include <Eigen/Sparse>
+
+using namespace Eigen;
+
+typedef SparseMatrix<double> SpMat;
+typedef SparseMatrix<double, RowMajor> SpMatRow;
+
+// a symmetric positive definite operator applied without the assembled matrix
+class MatrixFreeOperator {
+public:
+    virtual ~MatrixFreeOperator() {};
+    // y = A x
+    virtual void multiply(const MatrixXd& x, MatrixXd& y) const = 0;
+};
+
+// SimplicialLDLT whose diagonal is read in place; vectorD() returns a copy
+template<class MatrixType, class Ordering=AMDOrdering<int> >
+class SimplicialLDLTDiag : public SimplicialLDLT<MatrixType, Lower, Ordering> {
+public:
+    const typename SimplicialLDLT<MatrixType, Lower, Ordering>::VectorType& diagonal() const { return this->m_diag; }
+};
+
+// x = A^{-1} b with a simplicial Cholesky factorisation of Eigen (LDLT or LLT).
+// Eigen permutes the solution back in place, which allocates a mask; here it goes through work.
+// x may be the same matrix as b.
+template<class Scalar, class Ordering>
+void divideDiagonal(const SimplicialLDLTDiag<SparseMatrix<Scalar>, Ordering>& dec, Matrix<Scalar,Dynamic,Dynamic>& work){
+    work = dec.diagonal().asDiagonal().inverse() * work;
+}
+template<class Scalar, class Ordering>
+void divideDiagonal(const SimplicialLLT<SparseMatrix<Scalar>, Lower, Ordering>&, Matrix<Scalar,Dynamic,Dynamic>&){}
+template<class Decomposition, class Scalar>
+void choleskySolve(const Decomposition& dec, const Matrix<Scalar,Dynamic,Dynamic>& b, Matrix<Scalar,Dynamic,Dynamic>& x,
+                   Matrix<Scalar,Dynamic,Dynamic>& work){
+    bool isPermuted = dec.permutationP().size() > 0;
+    if(isPermuted){
+        work = dec.permutationP() * b;
+    }else{
+        work = b;
+    }
+    dec.matrixL().solveInPlace(work);
+    divideDiagonal(dec, work);
+    dec.matrixU().solveInPlace(work);
+    if(isPermuted){
+        x = dec.permutationPinv() * work;
+    }else{
+        x = work;
+    }
+}
+
+// hierarchy of smoothed aggregation for a symmetric positive definite matrix.
+// Unknowns strongly connected in the matrix (for ARAP, the vertices sharing a tet) are aggregated,
+// the piecewise constant prolongation is smoothed by a damped Jacobi step, and the coarse matrices
+// are the Galerkin products. Damped Jacobi is the smoother and the coarsest level is factorised.
+// With a matrix free operator, the finest matrix is used only to build the hierarchy.
+class Multigrid {
+public:
+    int maxLevel;
+    int minCoarseSize;   // levels are added until the system is this small
+    int numSmooth;   // number of pre and post smoothing sweeps
+    double strength;   // threshold of strong connection
+    // buffers of the cycles, kept by the caller so that repeated cycles do not allocate
+    struct Workspace {
+        std::vector<MatrixXd> Ax, bc, xc;   // for each level
+        MatrixXd coarse;
+    };
+    Multigrid(): maxLevel(10), minCoarseSize(256), numSmooth(2), strength(0.08), op(0) {};
+    // returns false on failure
+    bool compute(const SpMat& A, const MatrixFreeOperator* op=0);
+    // a V-cycle improving x for A x = b
+    void cycle(const MatrixXd& b, MatrixXd& x, Workspace& w) const;
+    // z = (a V-cycle from zero) r, as a preconditioner
+    void precondition(const MatrixXd& r, MatrixXd& z, Workspace& w) const {
+        z.setZero(r.rows(), r.cols());
+        cycle(r, z, w);
+    }
+    // y = A x with the finest matrix
+    void multiply(const MatrixXd& x, MatrixXd& y) const { multiply(0, x, y); }
+    int numLevel() const { return (int)level.size(); }
+    size_t bytes() const;
+private:
+    struct Level {
+        SpMatRow A;   // empty at the finest level if matrix free
+        SpMat P;   // prolongation from the next level
+        VectorXd invDiag;
+        double omega;   // damping of Jacobi
+    };
+    std::vector<Level> level;
+    SimplicialLDLTDiag<SpMat> coarseSolver;
+    const MatrixFreeOperator* op;
+    void multiply(int l, const MatrixXd& x, MatrixXd& y) const;
+    void smooth(int l, const MatrixXd& b, MatrixXd& x, MatrixXd& Ax) const;
+    void cycle(int l, const MatrixXd& b, MatrixXd& x, Workspace& w) const;
+    int aggregate(const SpMatRow& A, std::vector<int>& agg) const;
+    double spectralRadius(const SpMatRow& A, const VectorXd& invDiag) const;
+};
+
+void Multigrid::multiply(int l, const MatrixXd& x, MatrixXd& y) const{
+    if(l == 0 && op){
+        op->multiply(x, y);
+    }else{
+        y.noalias() = level[l].A * x;
+    }
+}
+
+// greedy aggregation over the strong connections; returns the number of aggregates
+int Multigrid::aggregate(const SpMatRow& A, std::vector<int>& agg) const{
+    int n = (int)A.rows();
+    VectorXd diag = A.diagonal().cwiseAbs();
+    // strong neighbours
+    std::vector<int> offset(n+1, 0), nbr;
+    for(int i=0;i<n;i++){
+        for(SpMatRow::InnerIterator it(A,i); it; ++it){
+            int j = (int)it.col();
+            if(j != i && std::abs(it.value()) >= strength * std::sqrt(diag[i]*diag[j])){
+                nbr.push_back(j);
+            }
+        }
+        offset[i+1] = (int)nbr.size();
+    }
+    agg.assign(n, -1);
+    int numAgg = 0;
+    // an unknown and its strong neighbours, if none of them is taken yet
+    for(int i=0;i<n;i++){
+        if(agg[i] >= 0) continue;
+        bool isFree = true;
+        for(int k=offset[i];k<offset[i+1] && isFree;k++){
+            isFree = agg[nbr[k]] < 0;
+        }
+        if(!isFree || offset[i] == offset[i+1]) continue;
+        agg[i] = numAgg;
+        for(int k=offset[i];k<offset[i+1];k++){
+            agg[nbr[k]] = numAgg;
+        }
+        numAgg++;
+    }
+    // the rest joins an aggregate of a strong neighbour
+    std::vector<int> joined(agg);
+    for(int i=0;i<n;i++){
+        if(agg[i] >= 0) continue;
+        for(int k=offset[i];k<offset[i+1];k++){
+            if(agg[nbr[k]] >= 0){
+                joined[i] = agg[nbr[k]];
+                break;
+            }
+        }
+    }
+    agg.swap(joined);
+    // isolated unknowns form their own aggregates
+    for(int i=0;i<n;i++){
+        if(agg[i] < 0) agg[i] = numAgg++;
+    }
+    return numAgg;
+}
+
+// largest eigenvalue of D^{-1} A by power iteration
+double Multigrid::spectralRadius(const SpMatRow& A, const VectorXd& invDiag) const{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    VectorXd x(A.rows());
+    for(int i=0;i<x.size();i++){
+        x[i] = uniform(rng);
+    }
+    double rho = 1.0;
+    for(int k=0;k<15;k++){
+        x.normalize();
+        VectorXd y = invDiag.asDiagonal() * (A * x);
+        rho = y.norm();
+        x = y;
+    }
+    return rho;
+}
+
+bool Multigrid::compute(const SpMat& A0, const MatrixFreeOperator* _op){
+    op = _op;
+    level.clear();
+    SpMatRow A = A0;
+    while((int)level.size()+1 < maxLevel && A.rows() > minCoarseSize){
+        int n = (int)A.rows();
+        std::vector<int> agg;
+        int numAgg = aggregate(A, agg);
+        // coarsening has stalled
+        if(numAgg >= n) break;
+        Level L;
+        L.invDiag = A.diagonal().cwiseInverse();
+        if(!L.invDiag.allFinite()) return false;
+        L.omega = 4.0 / (3.0 * spectralRadius(A, L.invDiag));
+        // tentative prolongation with normalised columns
+        std::vector<int> aggSize(numAgg, 0);
+        for(int i=0;i<n;i++){
+            aggSize[agg[i]]++;
+        }
+        SpMat Pt(n, numAgg);
+        Pt.reserve(Map<VectorXi>(aggSize.data(), numAgg));
+        for(int i=0;i<n;i++){
+            Pt.insert(i, agg[i]) = 1.0 / std::sqrt((double)aggSize[agg[i]]);
+        }
+        Pt.makeCompressed();
+        // P = (I - omega D^{-1} A) Pt
+        SpMat AP = A * Pt;
+        for(int c=0;c<AP.outerSize();c++){
+            for(SpMat::InnerIterator it(AP,c); it; ++it){
+                it.valueRef() *= -L.omega * L.invDiag[it.row()];
+            }
+        }
+        L.P = Pt + AP;
+        AP = A * L.P;
+        SpMatRow coarse = L.P.transpose() * AP;
+        if(!(level.empty() && op)){
+            L.A.swap(A);
+        }
+        level.push_back(L);
+        A.swap(coarse);
+    }
+    // the coarsest level
+    Level L;
+    L.invDiag = A.diagonal().cwiseInverse();
+    L.omega = 1.0;
+    coarseSolver.compute(SpMat(A));
+    if(!(level.empty() && op)){
+        L.A.swap(A);
+    }
+    level.push_back(L);
+    return coarseSolver.info() == Success;
+}
+
+// damped Jacobi sweeps
+void Multigrid::smooth(int l, const MatrixXd& b, MatrixXd& x, MatrixXd& Ax) const{
+    for(int k=0;k<numSmooth;k++){
+        multiply(l, x, Ax);
+        x.noalias() += level[l].omega * (level[l].invDiag.asDiagonal() * (b - Ax));
+    }
+}
+
+void Multigrid::cycle(const MatrixXd& b, MatrixXd& x, Workspace& w) const{
+    if(w.Ax.size() != level.size()){
+        w.Ax.resize(level.size());
+        w.bc.resize(level.size());
+        w.xc.resize(level.size());
+    }
+    cycle(0, b, x, w);
+}
+
+// the same number of sweeps before and after the correction keeps the cycle symmetric
+void Multigrid::cycle(int l, const MatrixXd& b, MatrixXd& x, Workspace& w) const{
+    if(l+1 == (int)level.size()){
+        choleskySolve(coarseSolver, b, x, w.coarse);
+        return;
+    }
+    const Level& L = level[l];
+    MatrixXd &Ax = w.Ax[l], &bc = w.bc[l], &xc = w.xc[l];
+    smooth(l, b, x, Ax);
+    multiply(l, x, Ax);
+    Ax = b - Ax;
+    bc.noalias() = L.P.transpose() * Ax;
+    xc.setZero(bc.rows(), bc.cols());
+    cycle(l+1, bc, xc, w);
+    x.noalias() += L.P * xc;
+    smooth(l, b, x, Ax);
+}
+
+size_t Multigrid::bytes() const{
+    size_t s = 0;
+    for(size_t l=0;l<level.size();l++){
+        const Level& L = level[l];
+        s += (size_t)L.A.nonZeros() * (sizeof(double) + sizeof(int)) + (size_t)(L.A.outerSize()+1) * sizeof(int);
+        s += (size_t)L.P.nonZeros() * (sizeof(double) + sizeof(int)) + (size_t)(L.P.outerSize()+1) * sizeof(int);
+        s += L.invDiag.size() * sizeof(double);
+    }
+    const SpMat& C = coarseSolver.matrixL().nestedExpression();
+    s += (size_t)C.nonZeros() * (sizeof(double) + sizeof(int)) + (size_t)(C.outerSize()+1) * sizeof(int);
+    return s;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file probeWeight.h
+ * @brief storage of probe weights
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "deformerConst.h"
+
+// weights of probes on elements (points or tets) for the rotation, shear and translation channels.
+// The channels share a single field unless they actually differ (as in WM_DRAW).
+// Rows are kept in a single contiguous table in double, float or 16-bit fixed point;
+// a fixed point row is scaled by its largest absolute value.
+class ProbeWeight {
+public:
+    int numElem, numPrb;
+    int numChannel;   // 1 when shared, 3 when independent
+    short precision;
+    ProbeWeight(): numElem(0), numPrb(0), numChannel(0), precision(WP_DOUBLE) {};
+    void setNum(int _numElem, int _numPrb, bool isShared, short _precision);
+    bool isShared() const { return numChannel == 1; }
+    // store the weights of the j-th element
+    void setRow(int channel, int j, const std::vector<double>& w);
+    // entries can also be given one by one by set() between startRows() and finishRows(),
+    // which passes every row through f(double* w, int n) in place (e.g. to normalise it).
+    // A fixed point row is scaled only when it is complete, so its entries are staged in float meanwhile.
+    void startRows();
+    void set(int channel, int j, int i, double w);
+    template<class F> void finishRows(const F& f);
+    // weights of the j-th element; the row is expanded into buf
+    std::vector<double>& row(int channel, int j, std::vector<double>& buf) const;
+    // the weight of the i-th probe on the j-th element
+    double operator()(int channel, int j, int i) const;
+    size_t bytes() const;
+private:
+    std::vector<double> wd;
+    std::vector<float> wf;
+    std::vector<short> wq;
+    std::vector<float> scale;   // per row scale for fixed point
+    size_t offset(int channel, int j) const {
+        return ((size_t)(channel < numChannel ? channel : 0) * numElem + j) * numPrb;
+    }
+    void quantise(size_t o, const double* w);
+};
+
+// allocate the weight table; storage of other precisions is released
+void ProbeWeight::setNum(int _numElem, int _numPrb, bool isShared, short _precision){
+    numElem = _numElem;
+    numPrb = _numPrb;
+    numChannel = isShared ? 1 : 3;
+    precision = _precision;
+    size_t size = (size_t)numChannel * numElem * numPrb;
+    if(precision == WP_DOUBLE){
+        wd.resize(size);
+    }else{
+        std::vector<double>().swap(wd);
+    }
+    if(precision == WP_FLOAT){
+        wf.resize(size);
+    }else{
+        std::vector<float>().swap(wf);
+    }
+    if(precision == WP_FIXED16){
+        wq.resize(size);
+        scale.resize(numChannel * numElem);
+    }else{
+        std::vector<short>().swap(wq);
+        std::vector<float>().swap(scale);
+    }
+}
+
+void ProbeWeight::setRow(int channel, int j, const std::vector<double>& w){
+    size_t o = offset(channel, j);
+    if(precision == WP_DOUBLE){
+        for(int i=0;i<numPrb;i++){
+            wd[o+i] = w[i];
+        }
+    }else if(precision == WP_FLOAT){
+        for(int i=0;i<numPrb;i++){
+            wf[o+i] = (float) w[i];
+        }
+    }else{
+        quantise(o, w.data());
+    }
+}
+
+// a fixed point row is scaled by its largest absolute value
+void ProbeWeight::quantise(size_t o, const double* w){
+    double m = 0.0;
+    for(int i=0;i<numPrb;i++){
+        m = std::max(m, std::abs(w[i]));
+    }
+    scale[o/numPrb] = (float) (m / 32767.0);
+    double s = m > 0 ? 32767.0 / m : 0.0;
+    for(int i=0;i<numPrb;i++){
+        wq[o+i] = (short) std::floor(w[i] * s + 0.5);
+    }
+}
+
+void ProbeWeight::startRows(){
+    if(precision == WP_FIXED16){
+        wf.resize(wq.size());
+    }
+}
+
+void ProbeWeight::set(int channel, int j, int i, double w){
+    size_t o = offset(channel, j) + i;
+    if(precision == WP_DOUBLE){
+        wd[o] = w;
+    }else{
+        wf[o] = (float) w;
+    }
+}
+
+template<class F>
+void ProbeWeight::finishRows(const F& f){
+    int numRow = numChannel * numElem;
+    if(precision == WP_DOUBLE){
+#pragma omp parallel for
+        for(int r=0;r<numRow;r++){
+            f(&wd[(size_t)r*numPrb], numPrb);
+        }
+        return;
+    }
+#pragma omp parallel
+    {
+        std::vector<double> buf(numPrb);
+#pragma omp for
+        for(int r=0;r<numRow;r++){
+            size_t o = (size_t)r*numPrb;
+            for(int i=0;i<numPrb;i++){
+                buf[i] = wf[o+i];
+            }
+            f(buf.data(), numPrb);
+            if(precision == WP_FLOAT){
+                for(int i=0;i<numPrb;i++){
+                    wf[o+i] = (float) buf[i];
+                }
+            }else{
+                quantise(o, buf.data());
+            }
+        }
+    }
+    // the staging of fixed point entries is released
+    if(precision == WP_FIXED16){
+        std::vector<float>().swap(wf);
+    }
+}
+
+std::vector<double>& ProbeWeight::row(int channel, int j, std::vector<double>& buf) const{
+    size_t o = offset(channel, j);
+    buf.resize(numPrb);
+    if(precision == WP_DOUBLE){
+        for(int i=0;i<numPrb;i++){
+            buf[i] = wd[o+i];
+        }
+    }else if(precision == WP_FLOAT){
+        for(int i=0;i<numPrb;i++){
+            buf[i] = wf[o+i];
+        }
+    }else{
+        double s = scale[o/numPrb];
+        for(int i=0;i<numPrb;i++){
+            buf[i] = s * wq[o+i];
+        }
+    }
+    return buf;
+}
+
+double ProbeWeight::operator()(int channel, int j, int i) const{
+    size_t o = offset(channel, j) + i;
+    if(precision == WP_DOUBLE){
+        return wd[o];
+    }else if(precision == WP_FLOAT){
+        return wf[o];
+    }else{
+        return (double) scale[o/numPrb] * wq[o];
+    }
+}
+
+// memory occupied by the table
+size_t ProbeWeight::bytes() const{
+    return wd.size()*sizeof(double) + wf.size()*sizeof(float)
+        + wq.size()*sizeof(short) + scale.size()*sizeof(float);
+}
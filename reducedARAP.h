@@ -0,0 +1,207 @@
+/**
+ * @file reducedARAP.h
+ * @brief ARAP restricted to a low dimensional subspace
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#pragma once
+
+#include <vector>
+#include <random>
+#include <limits>
+#include <Eigen/Dense>
+
+#include "laplacian.h"
+#include "probeWeight.h"
+
+using namespace Eigen;
+
+// ARAP solved in the span of the linear blend modes of the probes (w_j * (x,y,z,1)),
+// the global affine modes and a few of the smoothest eigenvectors of the system matrix.
+// The basis is orthonormal with respect to the system matrix, so that the global step
+// is a product with a small dense matrix.
+// The local step is evaluated only at sample tets chosen by farthest point sampling;
+// every tet takes the target of the nearest sample, so the right hand side is summed over
+// the clusters of the samples in advance.
+class ReducedARAP {
+public:
+    int numMode;   // dimension of the subspace
+    std::vector<int> sampleTet;   // tets at which the local step is evaluated
+    std::vector<int> cluster;   // the sample representing each tet
+    std::vector<Matrix4d> sampleTarget;   // target matrices of the samples
+    MatrixXd basis;   // dim x numMode
+    MatrixXd q;   // reduced coordinates (numMode x 3)
+    ReducedARAP(): numMode(0) {};
+    int numSample() const { return (int)sampleTet.size(); }
+    // build the subspace and the cubature from the factorised full system of mesh
+    int precompute(const Laplacian& mesh, const ProbeWeight& W, const std::vector<Vector3d>& tetCenter,
+                   int numEigen, int maxSample);
+    // take the targets of the samples out of the matrices of all the tets
+    void setTargets(const std::vector<Matrix4d>& targetMat);
+    // global step with the current targets of the samples
+    void solve(const MatrixXd& constraintVal);
+    // the deformed s-th sample tet; ghost vertices are taken from the reduced solution
+    Matrix4d sampleMatrix(int s) const;
+    // the positions of all the vertices
+    void expand(MatrixXd& Sol) const { Sol.noalias() = basis * q; }
+private:
+    MatrixXd sampleRhsOperator;   // 4numSample x numMode: (basis^T * rhsOperator)^T summed over each cluster
+    MatrixXd reducedConstraint;   // basis^T * constraintOperator
+    MatrixXd sampleBasis;   // rows of the basis at the corners of the samples
+    MatrixXd packedTarget;
+    void sample(const std::vector<Vector3d>& tetCenter, int maxSample);
+};
+
+// farthest point sampling of the tet centres; each tet is assigned to the nearest sample
+void ReducedARAP::sample(const std::vector<Vector3d>& tetCenter, int maxSample){
+    int numTet = (int)tetCenter.size();
+    int numSample = std::max(1, std::min(maxSample, numTet));
+    sampleTet.resize(numSample);
+    cluster.assign(numTet, 0);
+    std::vector<double> dist(numTet, std::numeric_limits<double>::max());
+    int next = 0;
+    for(int s=0;s<numSample;s++){
+        sampleTet[s] = next;
+        const Vector3d c = tetCenter[next];
+#pragma omp parallel for
+        for(int i=0;i<numTet;i++){
+            double d = (tetCenter[i]-c).squaredNorm();
+            if(d < dist[i]){
+                dist[i] = d;
+                cluster[i] = s;
+            }
+        }
+        next = (int)(std::max_element(dist.begin(), dist.end()) - dist.begin());
+    }
+}
+
+int ReducedARAP::precompute(const Laplacian& mesh, const ProbeWeight& W, const std::vector<Vector3d>& tetCenter,
+                            int numEigen, int maxSample){
+    int dim = mesh.dim;
+    int numTet = mesh.numTet;
+    int numPrb = W.numPrb;
+    sample(tetCenter, maxSample);
+    // rest positions of all the vertices including ghost ones, and the probe weights averaged over the tets around them
+    MatrixXd restPts(dim, 3);
+    MatrixXd ptsWeight = MatrixXd::Zero(dim, numPrb);
+    VectorXd count = VectorXd::Zero(dim);
+    std::vector<double> w;
+    for(int i=0;i<numTet;i++){
+        W.row(WC_ROTATION, i, w);
+        for(int m=0;m<4;m++){
+            int v = mesh.tetList[4*i+m];
+            restPts.row(v) = mesh.tetMatrix[i].block<1,3>(m,0);
+            ptsWeight.row(v) += Map<RowVectorXd>(w.data(), numPrb);
+            count[v] += 1.0;
+        }
+    }
+    for(int v=0;v<dim;v++){
+        if(count[v]>0) ptsWeight.row(v) /= count[v];
+    }
+    // candidate modes
+    MatrixXd U0(dim, 4*numPrb + 4 + numEigen);
+    for(int j=0;j<numPrb;j++){
+        for(int k=0;k<3;k++){
+            U0.col(4*j+k) = ptsWeight.col(j).cwiseProduct(restPts.col(k));
+        }
+        U0.col(4*j+3) = ptsWeight.col(j);
+    }
+    U0.middleCols(4*numPrb, 3) = restPts;
+    U0.col(4*numPrb+3).setOnes();
+    // smoothest eigenvectors by subspace iteration with the factorised system
+    if(numEigen>0){
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+        MatrixXd X(dim, numEigen), Y;
+        for(int k=0;k<numEigen;k++){
+            for(int v=0;v<dim;v++){
+                X(v,k) = uniform(rng);
+            }
+        }
+        for(int it=0;it<10;it++){
+            Y = X;
+            mesh.solver->solve(X, Y);
+            HouseholderQR<MatrixXd> qr(Y);
+            X = qr.householderQ() * MatrixXd::Identity(dim, numEigen);
+        }
+        U0.rightCols(numEigen) = X;
+    }
+    // orthonormalise with respect to K, dropping dependent modes
+    MatrixXd KU0;
+    mesh.multiply(U0, KU0);
+    MatrixXd M = U0.transpose() * KU0;
+    SelfAdjointEigenSolver<MatrixXd> eig(M);
+    if(eig.info() != Success){
+        MGlobal::displayInfo("Reduced basis could not be computed");
+        return ERROR_ARAP_PRECOMPUTE;
+    }
+    const VectorXd& lambda = eig.eigenvalues();
+    double threshold = 1e-10 * lambda.maxCoeff();
+    int first = 0;
+    while(first < lambda.size() && lambda[first] <= threshold) first++;
+    numMode = (int)lambda.size() - first;
+    if(numMode == 0){
+        MGlobal::displayInfo("Reduced basis could not be computed");
+        return ERROR_ARAP_PRECOMPUTE;
+    }
+    VectorXd invSqrt = lambda.tail(numMode).cwiseSqrt().cwiseInverse();
+    basis.noalias() = U0 * (eig.eigenvectors().rightCols(numMode) * invSqrt.asDiagonal());
+    // cubature: the right hand side of the tets of a cluster is summed into its sample
+    // (see Laplacian::makeRhsOperator for the element operator K_i)
+    std::vector<int> pairs(2*numTet);
+    for(int i=0;i<numTet;i++){
+        pairs[2*i] = cluster[i];
+        pairs[2*i+1] = i;
+    }
+    std::vector<int> offset, member;
+    Tetrise::makeCompressedRows(numSample(), pairs, offset, member);
+    Matrix4d diag=Matrix4d::Identity();
+    diag(3,3)=mesh.transWeight;
+    sampleRhsOperator.setZero(4*numSample(), numMode);
+    sampleBasis.resize(4*numSample(), numMode);
+#pragma omp parallel for schedule(dynamic)
+    for(int s=0;s<numSample();s++){
+        MatrixXd corner(4, numMode);
+        for(int k=offset[s];k<offset[s+1];k++){
+            int i = member[k];
+            Matrix4d Ki = mesh.tetWeight[i] * mesh.tetMatrixInverse[i].transpose() * diag;
+            for(int m=0;m<4;m++){
+                corner.row(m) = basis.row(mesh.tetList[4*i+m]);
+            }
+            sampleRhsOperator.middleRows(4*s, 4).noalias() += Ki.transpose() * corner;
+        }
+        for(int m=0;m<4;m++){
+            sampleBasis.row(4*s+m) = basis.row(mesh.tetList[4*sampleTet[s]+m]);
+        }
+    }
+    reducedConstraint = (mesh.constraintOperator.transpose() * basis).transpose();
+    q.setZero(numMode, 3);
+    return 0;
+}
+
+void ReducedARAP::setTargets(const std::vector<Matrix4d>& targetMat){
+    sampleTarget.resize(numSample());
+    for(int s=0;s<numSample();s++){
+        sampleTarget[s] = targetMat[sampleTet[s]];
+    }
+}
+
+void ReducedARAP::solve(const MatrixXd& constraintVal){
+    packedTarget.resize(4*numSample(), 3);
+    for(int s=0;s<numSample();s++){
+        packedTarget.block<4,3>(4*s,0) = sampleTarget[s].leftCols<3>();
+    }
+    q.noalias() = sampleRhsOperator.transpose() * packedTarget;
+    q.noalias() += reducedConstraint * constraintVal;
+}
+
+Matrix4d ReducedARAP::sampleMatrix(int s) const{
+    Matrix4d m;
+    m.leftCols<3>() = sampleBasis.middleRows<4>(4*s) * q;
+    m.col(3).setOnes();
+    return m;
+}
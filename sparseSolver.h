@@ -0,0 +1,446 @@
+/**
+ * @file sparseSolver.h
+ * @brief sparse linear solvers selectable at runtime
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library, (optional) SuiteSparse
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#pragma once
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseLU>
+#include <Eigen/IterativeLinearSolvers>
+
+#include "deformerConst.h"
+#include "multigrid.h"
+#include "domainDecomposition.h"
+
+//#define _SuiteSparse
+
+#ifdef _SuiteSparse
+#include <Eigen/CholmodSupport>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Eigen;
+
+typedef SparseMatrix<double> SpMat;
+typedef SparseMatrix<float> SpMatF;
+
+// memory occupied by a compressed sparse matrix
+template<class SparseType>
+size_t sparseBytes(const SparseType& A){
+    return (size_t)A.nonZeros() * (sizeof(typename SparseType::Scalar) + sizeof(int)) + (size_t)(A.outerSize()+1) * sizeof(int);
+}
+
+// interface of the solvers of symmetric positive definite systems.
+// The time and the memory of the last factorisation are recorded, and so is the relative residual
+// of the solves by the solvers which measure it (0 otherwise).
+class SparseSolver {
+public:
+    double factorTime;   // in seconds
+    size_t factorBytes;
+    double residual;   // largest relative residual since resetResidual()
+    SparseSolver(): factorTime(0), factorBytes(0), residual(0) {};
+    virtual ~SparseSolver() {};
+    // factorise A; returns false on failure
+    bool compute(const SpMat& A){
+        MTimer timer;
+        timer.beginTimer();
+        bool isOk = factorise(A);
+        timer.endTimer();
+        factorTime = timer.elapsedTime();
+        return isOk;
+    }
+    // solve A x = b; x is used as the initial guess by iterative solvers
+    virtual void solve(const MatrixXd& b, MatrixXd& x) = 0;
+    // whether solve() can be called from several threads at once
+    virtual bool isThreadSafe() const { return true; }
+    // let the solver apply the matrix through op instead of keeping it; returns false if unsupported
+    virtual bool setOperator(const MatrixFreeOperator*){ return false; }
+    void resetResidual(){ residual = 0; }
+protected:
+    virtual bool factorise(const SpMat& A) = 0;
+    void recordResidual(double r){
+#pragma omp critical
+        residual = std::max(residual, r);
+    }
+};
+
+// buffers of the solves reused across calls. Each thread has its own, as solves may run in parallel;
+// the buffers are added outside parallel regions.
+template<class Workspace>
+class ThreadWorkspace {
+public:
+    Workspace& get(){
+        int thread = 0;
+#ifdef _OPENMP
+        if(omp_in_parallel()){
+            thread = omp_get_thread_num();
+        }else if((int)buf.size() < omp_get_max_threads()){
+            buf.resize(omp_get_max_threads());
+        }
+#endif
+        if(buf.empty()) buf.resize(1);
+        return buf[thread];
+    }
+private:
+    std::vector<Workspace> buf;
+};
+
+// size of the factors of the direct solvers
+template<class Scalar, class Ordering>
+size_t factorSize(SimplicialLDLT<SparseMatrix<Scalar>, Lower, Ordering>& dec){
+    return sparseBytes(dec.matrixL().nestedExpression()) + dec.vectorD().size() * sizeof(Scalar);
+}
+template<class Scalar, class Ordering>
+size_t factorSize(SimplicialLLT<SparseMatrix<Scalar>, Lower, Ordering>& dec){
+    return sparseBytes(dec.matrixL().nestedExpression());
+}
+template<class Scalar, class Ordering>
+size_t factorSize(SparseLU<SparseMatrix<Scalar>, Ordering>& dec){
+    return (size_t)(dec.nnzL() + dec.nnzU()) * (sizeof(Scalar) + sizeof(int));
+}
+#ifdef _SuiteSparse
+inline size_t factorSize(CholmodDecomposition<SpMat>& dec){
+    return dec.cholmod().memory_inuse;
+}
+// CHOLMOD solves through its shared workspace
+inline bool isThreadSafe(const CholmodDecomposition<SpMat>&){ return false; }
+#endif
+template<class Decomposition>
+bool isThreadSafe(const Decomposition&){ return true; }
+
+// x = A^{-1} b; the permutations of the solvers of Eigen go through work instead of being applied in place
+template<class Decomposition, class Scalar>
+void solveInto(const Decomposition& dec, const Matrix<Scalar,Dynamic,Dynamic>& b, Matrix<Scalar,Dynamic,Dynamic>& x,
+               Matrix<Scalar,Dynamic,Dynamic>&){
+    x = dec.solve(b);
+}
+template<class Scalar, class Ordering>
+void solveInto(const SimplicialLDLTDiag<SparseMatrix<Scalar>, Ordering>& dec, const Matrix<Scalar,Dynamic,Dynamic>& b,
+               Matrix<Scalar,Dynamic,Dynamic>& x, Matrix<Scalar,Dynamic,Dynamic>& work){
+    choleskySolve(dec, b, x, work);
+}
+template<class Scalar, class Ordering>
+void solveInto(const SimplicialLLT<SparseMatrix<Scalar>, Lower, Ordering>& dec, const Matrix<Scalar,Dynamic,Dynamic>& b,
+               Matrix<Scalar,Dynamic,Dynamic>& x, Matrix<Scalar,Dynamic,Dynamic>& work){
+    choleskySolve(dec, b, x, work);
+}
+
+// the supernodal triangular solve of SparseLU still allocates its work inside Eigen
+template<class Scalar, class Ordering>
+void solveInto(const SparseLU<SparseMatrix<Scalar>, Ordering>& dec, const Matrix<Scalar,Dynamic,Dynamic>& b,
+               Matrix<Scalar,Dynamic,Dynamic>& x, Matrix<Scalar,Dynamic,Dynamic>& work){
+    work = dec.rowsPermutation() * b;
+    dec.matrixL().solveInPlace(work);
+    dec.matrixU().solveInPlace(work);
+    x = dec.colsPermutation().inverse() * work;
+}
+
+// direct solvers of Eigen (and CHOLMOD)
+template<class Decomposition>
+class DirectSolver : public SparseSolver {
+public:
+    void solve(const MatrixXd& b, MatrixXd& x){
+        solveInto(dec, b, x, work.get());
+    }
+    bool isThreadSafe() const { return ::isThreadSafe(dec); }
+    Decomposition dec;
+protected:
+    ThreadWorkspace<MatrixXd> work;
+    bool factorise(const SpMat& A){
+        dec.compute(A);
+        if(dec.info() != Success) return false;
+        factorBytes = factorSize(dec);
+        return true;
+    }
+};
+
+// factorisation in single precision, with the solutions refined in double precision
+// against the original matrix until the relative residual falls below the tolerance
+template<class Decomposition>
+class MixedSolver : public SparseSolver {
+public:
+    int maxRefinement;
+    double tolerance;
+    MixedSolver(): maxRefinement(5), tolerance(1e-10) {};
+    void solve(const MatrixXd& b, MatrixXd& x){
+        Workspace& w = work.get();
+        double bNorm = std::max(b.norm(), EPSILON);
+        w.bf = b.cast<float>();
+        solveInto(dec, w.bf, w.xf, w.workf);
+        x = w.xf.template cast<double>();
+        w.r.noalias() = mat * x;
+        w.r = b - w.r;
+        double res = w.r.norm() / bNorm;
+        for(int k=0; k<maxRefinement && res>tolerance; k++){
+            w.bf = w.r.template cast<float>();
+            solveInto(dec, w.bf, w.xf, w.workf);
+            w.x1 = x + w.xf.template cast<double>();
+            w.r1.noalias() = mat * w.x1;
+            w.r1 = b - w.r1;
+            double res1 = w.r1.norm() / bNorm;
+            // stop if the refinement does not converge
+            if(res1 >= res) break;
+            x.swap(w.x1);
+            w.r.swap(w.r1);
+            res = res1;
+        }
+        recordResidual(res);
+    }
+    bool isThreadSafe() const { return ::isThreadSafe(dec); }
+    Decomposition dec;
+protected:
+    struct Workspace {
+        MatrixXf bf, xf, workf;
+        MatrixXd r, x1, r1;
+    };
+    ThreadWorkspace<Workspace> work;
+    SpMat mat;   // kept for the residual
+    bool factorise(const SpMat& A){
+        mat = A;
+        dec.compute(SpMatF(A.cast<float>()));
+        if(dec.info() != Success) return false;
+        factorBytes = factorSize(dec) + sparseBytes(mat);
+        return true;
+    }
+};
+
+// buffers of conjugateGradient, with those of the preconditioner
+template<class PreconditionerWorkspace>
+struct CGWorkspace {
+    MatrixXd r, z, p, Ap;
+    RowVectorXd bNorm, rz, rzNew, pAp, alpha, beta;
+    PreconditionerWorkspace pre;
+};
+
+// preconditioned conjugate gradient on the columns of b, each with its own step lengths.
+// A.multiply(x, y) sets y = A x and M.precondition(r, z, w.pre) sets z = M^{-1} r.
+// x is the initial guess; returns the largest relative residual.
+template<class Operator, class Preconditioner>
+double conjugateGradient(const Operator& A, const Preconditioner& M, const MatrixXd& b, MatrixXd& x,
+                         int maxIteration, double tolerance, CGWorkspace<typename Preconditioner::Workspace>& w){
+    int cols = (int)b.cols();
+    w.bNorm = b.colwise().norm().cwiseMax(EPSILON);
+    A.multiply(x, w.r);
+    w.r = b - w.r;
+    double res = w.r.colwise().norm().cwiseQuotient(w.bNorm).maxCoeff();
+    if(res <= tolerance) return res;
+    M.precondition(w.r, w.z, w.pre);
+    w.p = w.z;
+    w.rz = w.r.cwiseProduct(w.z).colwise().sum();
+    w.alpha.resize(cols);
+    w.beta.resize(cols);
+    for(int k=0; k<maxIteration && res>tolerance; k++){
+        A.multiply(w.p, w.Ap);
+        w.pAp = w.p.cwiseProduct(w.Ap).colwise().sum();
+        for(int c=0;c<cols;c++){
+            w.alpha[c] = w.pAp[c] > 0 ? w.rz[c] / w.pAp[c] : 0.0;
+        }
+        x.noalias() += w.p * w.alpha.asDiagonal();
+        w.r.noalias() -= w.Ap * w.alpha.asDiagonal();
+        res = w.r.colwise().norm().cwiseQuotient(w.bNorm).maxCoeff();
+        M.precondition(w.r, w.z, w.pre);
+        w.rzNew = w.r.cwiseProduct(w.z).colwise().sum();
+        for(int c=0;c<cols;c++){
+            w.beta[c] = w.rz[c] > 0 ? w.rzNew[c] / w.rz[c] : 0.0;
+        }
+        w.p = w.p * w.beta.asDiagonal();
+        w.p += w.z;
+        w.rz.swap(w.rzNew);
+    }
+    return res;
+}
+
+// conjugate gradient with incomplete Cholesky preconditioner, warm started from the previous solution
+class IterativeSolver : public SparseSolver {
+public:
+    typedef MatrixXd Workspace;
+    int maxIteration;   // 0 for twice the dimension
+    double tolerance;
+    IterativeSolver(): maxIteration(0), tolerance(1e-8) {};
+    void solve(const MatrixXd& b, MatrixXd& x){
+        if(x.rows() != b.rows() || x.cols() != b.cols()){
+            x.setZero(b.rows(), b.cols());
+        }
+        int numIteration = maxIteration > 0 ? maxIteration : 2*(int)mat.rows();
+        recordResidual(conjugateGradient(*this, *this, b, x, numIteration, tolerance, work.get()));
+    }
+    void multiply(const MatrixXd& x, MatrixXd& y) const { y.noalias() = mat * x; }
+    // z = (L L^T)^{-1} r with the scaled and permuted incomplete factor, as Eigen applies it
+    void precondition(const MatrixXd& r, MatrixXd& z, MatrixXd& w) const;
+protected:
+    SpMat mat;   // the solver only refers to the matrix
+    IncompleteCholesky<double> ic;
+    ThreadWorkspace< CGWorkspace<MatrixXd> > work;
+    bool factorise(const SpMat& A){
+        mat = A;
+        ic.compute(mat);
+        if(ic.info() != Success) return false;
+        factorBytes = sparseBytes(mat) + sparseBytes(ic.matrixL());
+        return true;
+    }
+};
+
+void IterativeSolver::precondition(const MatrixXd& r, MatrixXd& z, MatrixXd& w) const{
+    bool isPermuted = ic.permutationP().size() > 0;
+    if(isPermuted){
+        w = ic.permutationP() * r;
+    }else{
+        w = r;
+    }
+    w = ic.scalingS().asDiagonal() * w;
+    ic.matrixL().triangularView<Lower>().solveInPlace(w);
+    ic.matrixL().adjoint().triangularView<Upper>().solveInPlace(w);
+    w = ic.scalingS().asDiagonal() * w;
+    if(isPermuted){
+        z = ic.permutationP().inverse() * w;
+    }else{
+        z = w;
+    }
+}
+
+// smoothed aggregation multigrid, either iterated by itself or as the preconditioner of
+// conjugate gradient, warm started from the previous solution.
+class MultigridSolver : public SparseSolver {
+public:
+    bool isPCG;
+    int maxIteration;
+    double tolerance;
+    MultigridSolver(bool _isPCG): isPCG(_isPCG), maxIteration(100), tolerance(1e-8), op(0) {};
+    void solve(const MatrixXd& b, MatrixXd& x);
+    // a matrix free operator keeps its own buffers
+    bool isThreadSafe() const { return op == 0; }
+    bool setOperator(const MatrixFreeOperator* _op){
+        op = _op;
+        return true;
+    }
+protected:
+    Multigrid mg;
+    const MatrixFreeOperator* op;
+    ThreadWorkspace< CGWorkspace<Multigrid::Workspace> > work;
+    bool factorise(const SpMat& A){
+        if(!mg.compute(A, op)) return false;
+        factorBytes = mg.bytes();
+        return true;
+    }
+};
+
+void MultigridSolver::solve(const MatrixXd& b, MatrixXd& x){
+    if(x.rows() != b.rows() || x.cols() != b.cols()){
+        x.setZero(b.rows(), b.cols());
+    }
+    CGWorkspace<Multigrid::Workspace>& w = work.get();
+    if(isPCG){
+        recordResidual(conjugateGradient(mg, mg, b, x, maxIteration, tolerance, w));
+        return;
+    }
+    w.bNorm = b.colwise().norm().cwiseMax(EPSILON);
+    mg.multiply(x, w.r);
+    w.r = b - w.r;
+    double res = w.r.colwise().norm().cwiseQuotient(w.bNorm).maxCoeff();
+    for(int k=0; k<maxIteration && res>tolerance; k++){
+        mg.cycle(b, x, w.pre);
+        mg.multiply(x, w.r);
+        w.r = b - w.r;
+        res = w.r.colwise().norm().cwiseQuotient(w.bNorm).maxCoeff();
+    }
+    recordResidual(res);
+}
+
+// conjugate gradient preconditioned by additive Schwarz over subdomains solved in parallel,
+// warm started from the previous solution
+class SchwarzSolver : public SparseSolver {
+public:
+    int maxIteration;
+    double tolerance;
+    SchwarzSolver(): maxIteration(200), tolerance(1e-8), op(0) {};
+    void solve(const MatrixXd& b, MatrixXd& x){
+        if(x.rows() != b.rows() || x.cols() != b.cols()){
+            x.setZero(b.rows(), b.cols());
+        }
+        recordResidual(conjugateGradient(dd, dd, b, x, maxIteration, tolerance, work.get()));
+    }
+    // a matrix free operator keeps its own buffers
+    bool isThreadSafe() const { return op == 0; }
+    bool setOperator(const MatrixFreeOperator* _op){
+        op = _op;
+        return true;
+    }
+protected:
+    SchwarzPreconditioner dd;
+    const MatrixFreeOperator* op;
+    ThreadWorkspace< CGWorkspace<SchwarzPreconditioner::Workspace> > work;
+    bool factorise(const SpMat& A){
+        if(!dd.compute(A, op)) return false;
+        factorBytes = dd.bytes();
+        return true;
+    }
+};
+
+// create a solver of the given type (SOLVER_*).
+// With FO_NATURAL, the Eigen direct solvers factorise in the given order of unknowns
+// instead of computing a fill-reducing ordering (AMD for Cholesky, COLAMD for LU).
+// With isMixed, they factorise in single precision and refine the solutions (the other solvers are unaffected).
+SparseSolver* createSparseSolver(short type, short fillOrdering=FO_AMD, bool isMixed=false){
+    if(isMixed && fillOrdering == FO_NATURAL){
+        if(type == SOLVER_LDLT){
+            return new MixedSolver< SimplicialLDLTDiag<SpMatF, NaturalOrdering<int> > >;
+        }else if(type == SOLVER_LLT){
+            return new MixedSolver< SimplicialLLT<SpMatF, Lower, NaturalOrdering<int> > >;
+        }else if(type == SOLVER_LU){
+            return new MixedSolver< SparseLU<SpMatF, NaturalOrdering<int> > >;
+        }
+    }else if(isMixed){
+        if(type == SOLVER_LDLT){
+            return new MixedSolver< SimplicialLDLTDiag<SpMatF> >;
+        }else if(type == SOLVER_LLT){
+            return new MixedSolver< SimplicialLLT<SpMatF> >;
+        }else if(type == SOLVER_LU){
+            return new MixedSolver< SparseLU<SpMatF> >;
+        }
+    }
+    if(fillOrdering == FO_NATURAL){
+        if(type == SOLVER_LDLT){
+            return new DirectSolver< SimplicialLDLTDiag<SpMat, NaturalOrdering<int> > >;
+        }else if(type == SOLVER_LLT){
+            return new DirectSolver< SimplicialLLT<SpMat, Lower, NaturalOrdering<int> > >;
+        }else if(type == SOLVER_LU){
+            return new DirectSolver< SparseLU<SpMat, NaturalOrdering<int> > >;
+        }
+    }
+    switch(type){
+        case SOLVER_LLT:
+            return new DirectSolver< SimplicialLLT<SpMat> >;
+        case SOLVER_LU:
+            return new DirectSolver< SparseLU<SpMat> >;
+        case SOLVER_CHOLMOD:
+#ifdef _SuiteSparse
+        {
+            DirectSolver< CholmodDecomposition<SpMat> >* S = new DirectSolver< CholmodDecomposition<SpMat> >;
+            S->dec.setMode(CholmodSupernodalLLt);
+            return S;
+        }
+#else
+            MGlobal::displayInfo("CHOLMOD is not available: falling back to SimplicialLDLT");
+            return new DirectSolver< SimplicialLDLTDiag<SpMat> >;
+#endif
+        case SOLVER_CG:
+            return new IterativeSolver;
+        case SOLVER_MG:
+            return new MultigridSolver(false);
+        case SOLVER_CG_MG:
+            return new MultigridSolver(true);
+        case SOLVER_SCHWARZ:
+            return new SchwarzSolver;
+        default:
+            return new DirectSolver< SimplicialLDLTDiag<SpMat> >;
+    }
+}
@@ -0,0 +1,195 @@
+/**
+ * @file allocationTest.cpp
+ * @brief checks that the per-frame path makes no heap allocation once the sizes are stable
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#include <atomic>
+
+#include "testCommon.h"
+#include "../tetrise.h"
+#include "../laplacian.h"
+#include "../blendAff.h"
+#include "../probeWeight.h"
+
+using namespace Eigen;
+using namespace AffineLib;
+using namespace Tetrise;
+
+// every allocation goes through the counter; Eigen allocates with malloc, and so does new
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+static std::atomic<long> numAlloc(0);
+extern "C" void* malloc(size_t size){
+    numAlloc++;
+    return __libc_malloc(size);
+}
+extern "C" void* realloc(void* p, size_t size){
+    numAlloc++;
+    return __libc_realloc(p, size);
+}
+
+// the Maya independent part of the per-frame work of probeDeformerARAP and probeDeformer
+struct Frame {
+    int numPts, numPrb;
+    std::vector<Vector3d> pts, new_pts, deformed;
+    MeshTopology topo;
+    Laplacian mesh;
+    BlendAff B;
+    ProbeWeight W, WP;   // weights on tets and on points
+    BlendScratch scratch;
+    std::vector<Matrix4d> initMatrix, matrix, A, Q;
+    std::vector<Matrix3d> blendedS, blendedR;
+    std::vector<double> dummyWeight;
+    std::vector<T> constraint;
+
+    Frame(int n, int m, int _numPrb, short solverType, bool isMixed, bool isMatrixFree, short weightPrecision): numPrb(_numPrb){
+        makeTorus(n, m, pts, topo.faceList);
+        numPts = (int)pts.size();
+        makeTetList(TM_FACE, numPts, topo, mesh.tetList);
+        makeTetMatrix(TM_FACE, pts, mesh.tetList, topo, mesh.tetMatrix, mesh.tetWeight);
+        mesh.numTet = (int)mesh.tetList.size()/4;
+        mesh.dim = numPts + mesh.numTet;
+        mesh.transWeight = 0.0001;
+        mesh.computeTetMatrixInverse();
+        // each probe holds the vertex nearest to it
+        initMatrix.resize(numPrb);
+        matrix.resize(numPrb);
+        B.setNum(numPrb);
+        B.rotationConsistency = true;
+        for(int i=0;i<numPrb;i++){
+            int v = (int)((long)i * numPts / numPrb);
+            initMatrix[i] = pad(Matrix3d::Identity(), pts[v]);
+            B.centre[i] = pts[v];
+            constraint.push_back(T(i, v, 1.0));
+        }
+        mesh.constraintWeight.resize(constraint.size());
+        for(size_t k=0;k<constraint.size();k++){
+            mesh.constraintWeight[k] = std::make_pair(constraint[k].col(), constraint[k].value());
+        }
+        mesh.setSolver(solverType, FO_AMD, isMixed, isMatrixFree);
+        CHECK(mesh.ARAPprecompute() == 0);
+        // inverse distance weights
+        W.setNum(mesh.numTet, numPrb, true, weightPrecision);
+        WP.setNum(numPts, numPrb, true, weightPrecision);
+        std::vector<double> w(numPrb);
+        for(int j=0;j<mesh.numTet+numPts;j++){
+            Vector3d p = j<mesh.numTet ? transPart(mesh.tetMatrix[j]) : pts[j-mesh.numTet];
+            double sum = 0;
+            for(int i=0;i<numPrb;i++){
+                w[i] = 1.0/pow((p-B.centre[i]).norm()+0.1, 2);
+                sum += w[i];
+            }
+            for(int i=0;i<numPrb;i++){
+                w[i] /= sum;
+            }
+            if(j<mesh.numTet){
+                W.setRow(WC_ROTATION, j, w);
+            }else{
+                WP.setRow(WC_ROTATION, j-mesh.numTet, w);
+            }
+        }
+    }
+
+    // one evaluation with the probes turned by the angle t
+    void evaluate(double t, short blendMode, int numIter){
+        for(int i=0;i<numPrb;i++){
+            Matrix3d R = AngleAxisd(t*(i+1), Vector3d(0,0,1)).toRotationMatrix();
+            matrix[i] = pad(R, transPart(initMatrix[i]) + Vector3d(0, 0, t));
+            B.Aff[i] = initMatrix[i].inverse()*matrix[i];
+        }
+        B.parametrise(blendMode);
+        // blend on tets as probeDeformerARAP
+        blendedS.resize(mesh.numTet); blendedR.resize(mesh.numTet); A.resize(mesh.numTet);
+        scratch.resize(3, numPrb);
+#pragma omp parallel for
+        for(int j=0;j<mesh.numTet;j++){
+            const std::vector<double>& wr = W.row(WC_ROTATION, j, scratch.get(0));
+            A[j] = B.blend(blendMode, false, wr, wr, wr, blendedS[j], blendedR[j]);
+        }
+        mesh.constraintVal.resize(constraint.size(), 3);
+        for(size_t k=0;k<constraint.size();k++){
+            RowVector4d cv = pad(pts[constraint[k].col()]) * B.Aff[constraint[k].row()];
+            mesh.constraintVal.row(k) = cv.head<3>();
+        }
+        for(int k=0;k<numIter;k++){
+            mesh.ARAPSolve(A);
+            new_pts.resize(numPts);
+            for(int i=0;i<numPts;i++){
+                new_pts[i] = mesh.Sol.block<1,3>(i,0).transpose();
+            }
+            if(k+1<numIter){
+                makeTetMatrix(TM_FACE, new_pts, mesh.tetList, topo, Q, dummyWeight);
+#pragma omp parallel for
+                for(int i=0;i<mesh.numTet;i++){
+                    Matrix3d newS,newR;
+                    polarHigham((mesh.tetMatrixInverse[i]*Q[i]).block(0,0,3,3), newS, newR);
+                    A[i].block(0,0,3,3) = blendedS[i]*newR;
+                }
+            }
+        }
+        // blend on points as probeDeformer
+        deformed.resize(numPts);
+#pragma omp parallel for
+        for(int j=0;j<numPts;j++){
+            const std::vector<double>& wr = WP.row(WC_ROTATION, j, scratch.get(0));
+            Matrix3d SS,RR;
+            Matrix4d mat = B.blend(blendMode, false, wr, wr, wr, SS, RR);
+            deformed[j] = (pad(pts[j]) * mat).head<3>();
+        }
+    }
+};
+
+// allocations during the two frames after two warm-up frames
+long countAllocation(Frame& frame, short blendMode){
+    frame.evaluate(0.1, blendMode, 2);
+    frame.evaluate(0.2, blendMode, 2);
+    long before = numAlloc;
+    frame.evaluate(0.3, blendMode, 2);
+    frame.evaluate(0.4, blendMode, 2);
+    return numAlloc - before;
+}
+
+// solver backends with their options.
+// SparseLU allocates the work of its supernodal triangular solve inside Eigen, so it is only reported.
+struct SolverConfig {
+    const char* name;
+    short type;
+    bool isMixed, isMatrixFree;
+    bool isChecked;
+};
+
+int main(){
+    const short blendModes[] = {BM_SRL, BM_SSE, BM_LOG3, BM_LOG4, BM_SQL, BM_AFF};
+    const char* blendNames[] = {"SRL", "SSE", "LOG3", "LOG4", "SQL", "AFF"};
+    const SolverConfig solvers[] = {
+        {"LDLT", SOLVER_LDLT, false, false, true}, {"LLT", SOLVER_LLT, false, false, true},
+        {"LU", SOLVER_LU, false, false, false}, {"LDLT-mixed", SOLVER_LDLT, true, false, true},
+        {"LLT-mixed", SOLVER_LLT, true, false, true}, {"LU-mixed", SOLVER_LU, true, false, false},
+        {"CG", SOLVER_CG, false, false, true}, {"MG", SOLVER_MG, false, false, true},
+        {"CG-MG", SOLVER_CG_MG, false, false, true}, {"Schwarz", SOLVER_SCHWARZ, false, false, true},
+        {"MG-free", SOLVER_MG, false, true, true}, {"CG-MG-free", SOLVER_CG_MG, false, true, true},
+        {"Schwarz-free", SOLVER_SCHWARZ, false, true, true}
+    };
+    const int numSolver = sizeof(solvers)/sizeof(solvers[0]);
+    const short precisions[] = {WP_DOUBLE, WP_FLOAT, WP_FIXED16};
+    const char* precisionNames[] = {"double", "float", "fixed16"};
+    bool isOk = true;
+    for(int s=0;s<numSolver;s++){
+        for(int p=0;p<3;p++){
+            Frame frame(40, 30, 8, solvers[s].type, solvers[s].isMixed, solvers[s].isMatrixFree, precisions[p]);
+            for(int b=0;b<6;b++){
+                long n = countAllocation(frame, blendModes[b]);
+                std::printf("%-12s %-8s %-5s: %ld allocations\n", solvers[s].name, precisionNames[p], blendNames[b], n);
+                isOk &= (n == 0 || !solvers[s].isChecked);
+            }
+        }
+    }
+    CHECK(isOk);
+    std::printf("allocationTest passed\n");
+    return 0;
+}
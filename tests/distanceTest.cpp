@@ -0,0 +1,77 @@
+/**
+ * @file distanceTest.cpp
+ * @brief checks the distance tables and the closest element queries against brute force,
+ *        and the row-wise normalisation of weights given entry by entry
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#include "testCommon.h"
+#include "../distance.h"
+#include "../probeWeight.h"
+
+using namespace Eigen;
+
+int main(){
+    std::vector<Vector3d> pts, hdl;
+    std::vector<int> faceList;
+    makeTorus(60, 40, pts, faceList);
+    int numPts = (int)pts.size();
+    int numHdl = 17;
+    std::srand(1);
+    for(int i=0;i<numHdl;i++){
+        hdl.push_back(3*Vector3d::Random());
+    }
+    for(int s=0;s<2;s++){
+        bool isSingle = (s == 1);
+        Distance D;
+        D.setNum(numHdl, numPts, 0, isSingle);
+        D.computeDistPts(pts, hdl);
+        D.findClosestPts(pts, hdl);
+        D.findClosestTet(std::vector<Vector3d>(), hdl);
+        for(int i=0;i<numHdl;i++){
+            int closest = 0;
+            for(int j=0;j<numPts;j++){
+                double d = (pts[j]-hdl[i]).norm();
+                CHECK(std::abs(D.distPts(i,j) - d) <= (isSingle ? 1e-6 * d : 1e-14 * d));
+                if(d < (pts[closest]-hdl[i]).norm()) closest = j;
+            }
+            CHECK(D.closestPts[i] == closest);
+            CHECK(D.closestTet[i] == 0);
+        }
+        CHECK(D.distPts.bytes() == (size_t)numPts * numHdl * (isSingle ? sizeof(float) : sizeof(double)));
+    }
+    // weights given entry by entry and normalised in place agree with whole rows
+    Distance D;
+    for(short precision=WP_DOUBLE;precision<=WP_FIXED16;precision++){
+        ProbeWeight byRow, byEntry;
+        byRow.setNum(numPts, numHdl, true, precision);
+        byEntry.setNum(numPts, numHdl, true, precision);
+        byEntry.startRows();
+        std::vector<double> w(numHdl), a, b;
+        for(int j=0;j<numPts;j++){
+            for(int i=0;i<numHdl;i++){
+                w[i] = 1.0 / (pts[j]-hdl[i]).squaredNorm();
+                byEntry.set(0, j, i, w[i]);
+            }
+            D.normaliseWeight(NM_LINEAR, w);
+            byRow.setRow(0, j, w);
+        }
+        byEntry.finishRows(RowNormaliser(D, NM_LINEAR));
+        // the staged entries are rounded to float, which may move a fixed point entry by a step
+        double tol = precision == WP_DOUBLE ? 1e-14 : (precision == WP_FLOAT ? 1e-6 : 1.0 / 32767);
+        for(int j=0;j<numPts;j++){
+            byRow.row(0, j, a);
+            byEntry.row(0, j, b);
+            for(int i=0;i<numHdl;i++){
+                CHECK(std::abs(a[i] - b[i]) <= tol);
+            }
+        }
+        CHECK(byEntry.bytes() == byRow.bytes());
+    }
+    std::printf("distanceTest passed\n");
+    return 0;
+}
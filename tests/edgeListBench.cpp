@@ -0,0 +1,144 @@
+/**
+ * @file edgeListBench.cpp
+ * @brief compares the sort based edge extraction and tet adjacency with the former std::map implementation
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#include <map>
+
+#include "testCommon.h"
+#include "../tetrise.h"
+
+using namespace Eigen;
+using namespace Tetrise;
+
+// the former implementation, with std::map keyed by the pair of end points
+namespace MapBased{
+    typedef std::pair<int,int> couple;
+
+    void makeEdgeList(const std::vector<int>& faceList, std::vector<int>& edgeVertex, std::vector<int>& edgeFace){
+        edgeVertex.clear();
+        edgeFace.clear();
+        std::map< couple, int > edges;
+        int s,t;
+        for(int i=0;i<(int)faceList.size()/3;i++){
+            for(int j=0;j<3;j++){
+                s=faceList[3*i+j];
+                t=faceList[3*i+((j+1)%3)];
+                if(s>t) std::swap(s,t);
+                couple pa(s,t);
+                if( edges.find(pa) == edges.end() ){  // if not in the list
+                    edges[pa] = i;
+                }else{
+                    edgeVertex.push_back(s); edgeVertex.push_back(t);
+                    edgeFace.push_back(edges[pa]); edgeFace.push_back(i);
+                }
+            }
+        }
+    }
+
+    void makeAdjacencyList(const MeshTopology& topo, std::vector< std::vector<int> >& adjacencyList){
+        adjacencyList.assign(topo.fanOffset[topo.numFan()], std::vector<int>());
+        std::map< couple, int > edges;
+        int s,t,cur=0;
+        for(int i=0;i<topo.numFan();i++){
+            int num = topo.fanOffset[i+1]-topo.fanOffset[i];
+            std::vector<int> adj(num);
+            for(int j=0;j<num;j++){
+                adj[j] = cur+j;
+            }
+            for(int j=0;j<num;j++){
+                adjacencyList[cur].insert(adjacencyList[cur].end(), adj.begin(), adj.end());
+                // list of shared edges
+                s=topo.fanTriangle[2*cur];
+                t=topo.fanTriangle[2*cur+1];
+                couple pa1(topo.fanVertex[i],s),pa2(t,topo.fanVertex[i]);
+                if( edges.find(pa1) == edges.end() ){  // if not in the list
+                    edges[pa1] = cur;
+                }else{
+                    adjacencyList[cur].push_back(edges[pa1]);
+                    adjacencyList[edges[pa1]].push_back(cur);
+                }
+                if( edges.find(pa2) == edges.end() ){  // if not in the list
+                    edges[pa2] = cur;
+                }else{
+                    adjacencyList[cur].push_back(edges[pa2]);
+                    adjacencyList[edges[pa2]].push_back(cur);
+                }
+                cur++;
+            }
+        }
+    }
+}
+
+// triangle fans in the order of the faces, as makeVertexList makes them out of the polygons
+void makeFans(int numPts, MeshTopology& topo){
+    int numFace = topo.numFace();
+    topo.fanVertex.resize(numPts);
+    topo.fanOffset.assign(numPts+1, 0);
+    for(int i=0;i<numPts;i++){
+        topo.fanVertex[i] = i;
+    }
+    for(int k=0;k<3*numFace;k++){
+        topo.fanOffset[topo.faceList[k]+1]++;
+    }
+    for(int i=0;i<numPts;i++){
+        topo.fanOffset[i+1] += topo.fanOffset[i];
+    }
+    topo.fanTriangle.resize(2*topo.fanOffset[numPts]);
+    std::vector<int> cur(topo.fanOffset.begin(), topo.fanOffset.end()-1);
+    for(int f=0;f<numFace;f++){
+        for(int j=0;j<3;j++){
+            int k = cur[topo.faceList[3*f+j]]++;
+            topo.fanTriangle[2*k] = topo.faceList[3*f+(j+1)%3];
+            topo.fanTriangle[2*k+1] = topo.faceList[3*f+(j+2)%3];
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    int n = argc > 1 ? atoi(argv[1]) : 1000;
+    std::vector<Vector3d> pts;
+    MeshTopology topo;
+    makeTorus(n, n, pts, topo.faceList);
+    int numPts = (int)pts.size();
+    makeFans(numPts, topo);
+    std::printf("%d vertices, %d triangles\n", numPts, topo.numFace());
+
+    // edges
+    std::vector<int> edgeVertex, edgeFace;
+    double start = wallTime();
+    MapBased::makeEdgeList(topo.faceList, edgeVertex, edgeFace);
+    double mapTime = wallTime() - start;
+    start = wallTime();
+    makeEdgeList(topo);
+    double sortTime = wallTime() - start;
+    CHECK(topo.edgeVertex == edgeVertex);
+    CHECK(topo.edgeFace == edgeFace);
+    std::printf("edge list:         std::map %7.3f s, radix sort %7.3f s (x%.1f), %d edges\n",
+                mapTime, sortTime, mapTime/sortTime, topo.numEdge());
+
+    // adjacency of the tets around vertices
+    std::vector<int> tetList;
+    makeTetList(TM_VERTEX, numPts, topo, tetList);
+    std::vector< std::vector<int> > adjacencyList;
+    start = wallTime();
+    MapBased::makeAdjacencyList(topo, adjacencyList);
+    mapTime = wallTime() - start;
+    TetAdjacency adjacency;
+    start = wallTime();
+    makeAdjacencyList(TM_VERTEX, tetList, topo, adjacency);
+    sortTime = wallTime() - start;
+    CHECK(adjacency.offset.size() == adjacencyList.size()+1);
+    for(size_t i=0;i<adjacencyList.size();i++){
+        std::vector<int> row(adjacency.index.begin()+adjacency.offset[i], adjacency.index.begin()+adjacency.offset[i+1]);
+        CHECK(row == adjacencyList[i]);
+    }
+    std::printf("vertex adjacency:  std::map %7.3f s, radix sort %7.3f s (x%.1f), %d tets\n",
+                mapTime, sortTime, mapTime/sortTime, (int)tetList.size()/4);
+    return 0;
+}
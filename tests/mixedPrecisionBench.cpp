@@ -0,0 +1,87 @@
+/**
+ * @file mixedPrecisionBench.cpp
+ * @brief factorisation time, memory and accuracy of the mixed precision solvers compared with double
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#include "testCommon.h"
+#include "../tetrise.h"
+#include "../laplacian.h"
+
+using namespace Eigen;
+using namespace AffineLib;
+using namespace Tetrise;
+
+// the ARAP system of the torus with numPrb vertices held, as probeDeformerARAP sets it up
+void setupARAP(const std::vector<Vector3d>& pts, MeshTopology& topo, int numPrb, Laplacian& mesh){
+    int numPts = (int)pts.size();
+    makeTetList(TM_FACE, numPts, topo, mesh.tetList);
+    makeTetMatrix(TM_FACE, pts, mesh.tetList, topo, mesh.tetMatrix, mesh.tetWeight);
+    mesh.numTet = (int)mesh.tetList.size()/4;
+    mesh.dim = numPts + mesh.numTet;
+    mesh.transWeight = 0.0001;
+    mesh.computeTetMatrixInverse();
+    mesh.constraintWeight.resize(numPrb);
+    mesh.constraintVal.resize(numPrb, 3);
+    for(int i=0;i<numPrb;i++){
+        int v = (int)((long)i * numPts / numPrb);
+        mesh.constraintWeight[i] = std::make_pair(v, 1.0);
+        // the held vertices are lifted by turns
+        mesh.constraintVal.row(i) = (pts[v] + Vector3d(0, 0, 0.3*(i%2))).transpose();
+    }
+}
+
+int main(int argc, char** argv){
+    int n = argc > 1 ? atoi(argv[1]) : 300;
+    int numPrb = argc > 2 ? atoi(argv[2]) : 16;
+    std::vector<Vector3d> pts;
+    MeshTopology topo;
+    makeTorus(n, n/2, pts, topo.faceList);
+    int numPts = (int)pts.size();
+    Vector3d lower = pts[0], upper = pts[0];
+    for(int i=0;i<numPts;i++){
+        lower = lower.cwiseMin(pts[i]);
+        upper = upper.cwiseMax(pts[i]);
+    }
+    double diagonal = (upper-lower).norm();
+
+    struct SolverConfig {
+        const char* name;
+        short type;
+        bool isMixed;
+    };
+    const SolverConfig configs[] = {
+        {"LDLT", SOLVER_LDLT, false}, {"LDLT-mixed", SOLVER_LDLT, true},
+        {"LLT", SOLVER_LLT, false}, {"LLT-mixed", SOLVER_LLT, true},
+        {"LU", SOLVER_LU, false}, {"LU-mixed", SOLVER_LU, true},
+    };
+    std::printf("%d points, %d held vertices\n", numPts, numPrb);
+    std::printf("%-11s %10s %11s %12s %12s\n", "solver", "factor(s)", "factor(MB)", "residual", "max error");
+    MatrixXd reference;
+    for(size_t c=0;c<sizeof(configs)/sizeof(configs[0]);c++){
+        Laplacian mesh;
+        setupARAP(pts, topo, numPrb, mesh);
+        mesh.setSolver(configs[c].type, FO_AMD, configs[c].isMixed);
+        CHECK(mesh.ARAPprecompute() == 0);
+        // tets are turned about the axis of the torus by their height
+        std::vector<Matrix4d> A(mesh.numTet, Matrix4d::Identity());
+        for(int i=0;i<mesh.numTet;i++){
+            A[i] = pad(AngleAxisd(0.5*transPart(mesh.tetMatrix[i])[2], Vector3d(0,0,1)).toRotationMatrix(), Vector3d::Zero());
+        }
+        mesh.ARAPSolve(A);
+        // relative residual against the double system, and the deviation of the points from double LDLT
+        MatrixXd r = mesh.rhs - mesh.assembler.mat * mesh.Sol;
+        double residual = r.norm() / mesh.rhs.norm();
+        if(c == 0) reference = mesh.Sol;
+        double error = (mesh.Sol.topRows(numPts) - reference.topRows(numPts)).rowwise().norm().maxCoeff() / diagonal;
+        std::printf("%-11s %10.3f %11.2f %12.3g %12.3g\n", configs[c].name, mesh.solver->factorTime,
+                    mesh.solver->factorBytes / 1048576.0, residual, error);
+        CHECK(residual < 1e-8);
+        CHECK(error < 1e-6);
+    }
+    return 0;
+}
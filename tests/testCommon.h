@@ -0,0 +1,64 @@
+/**
+ * @file testCommon.h
+ * @brief stand-ins for the Maya classes used by the headers, and test meshes
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../affinelib.h"
+
+// the headers report through MGlobal and time the factorisation with MTimer
+class MString {
+public:
+    std::string s;
+    MString(const char* c): s(c) {};
+};
+class MGlobal {
+public:
+    static void displayInfo(const MString& m){ std::printf("%s\n", m.s.c_str()); }
+    static void displayWarning(const MString& m){ std::printf("warning: %s\n", m.s.c_str()); }
+};
+class MTimer {
+public:
+    void beginTimer(){ start = std::chrono::steady_clock::now(); }
+    void endTimer(){ end = std::chrono::steady_clock::now(); }
+    double elapsedTime(){ return std::chrono::duration<double>(end-start).count(); }
+private:
+    std::chrono::steady_clock::time_point start, end;
+};
+
+// seconds since the first call
+inline double wallTime(){
+    static std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-origin).count();
+}
+
+#define CHECK(cond) do{ if(!(cond)){ std::printf("FAILED: %s (%s:%d)\n", #cond, __FILE__, __LINE__); std::exit(1); } }while(0)
+
+// triangulated torus of n x m vertices
+inline void makeTorus(int n, int m, std::vector<Eigen::Vector3d>& pts, std::vector<int>& faceList){
+    pts.resize(n*m);
+    faceList.resize(6*n*m);
+    for(int i=0;i<n;i++){
+        double u = 2*M_PI*i/n;
+        for(int j=0;j<m;j++){
+            double v = 2*M_PI*j/m;
+            pts[i*m+j] << (2+cos(v))*cos(u), (2+cos(v))*sin(u), sin(v);
+            int a = i*m+j, b = ((i+1)%n)*m+j, c = ((i+1)%n)*m+(j+1)%m, d = i*m+(j+1)%m;
+            int f = 6*(i*m+j);
+            faceList[f] = a; faceList[f+1] = b; faceList[f+2] = c;
+            faceList[f+3] = a; faceList[f+4] = c; faceList[f+5] = d;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * @file weightStorageBench.cpp
+ * @brief memory, blend throughput and deformation error of the weight precisions compared with double
+ * @section LICENSE The MIT License
+ * @section requirements:  Eigen library
+ * @version 0.10
+ * @date  Oct. 2016
+ * @author Shizuo KAJI
+ */
+
+#include "testCommon.h"
+#include "../blendAff.h"
+#include "../probeWeight.h"
+#include "../distance.h"
+
+using namespace Eigen;
+using namespace AffineLib;
+
+int main(int argc, char** argv){
+    int n = argc > 1 ? atoi(argv[1]) : 400;
+    int numPrb = argc > 2 ? atoi(argv[2]) : 64;
+    std::vector<Vector3d> pts;
+    std::vector<int> faceList;
+    makeTorus(n, n/2, pts, faceList);
+    int numPts = (int)pts.size();
+    // probes at random points, turned and scaled
+    std::srand(1);
+    BlendAff B(numPrb);
+    B.rotationConsistency = true;
+    for(int i=0;i<numPrb;i++){
+        B.centre[i] = pts[std::rand() % numPts];
+        Matrix3d R = AngleAxisd(Vector3d::Random()[0]*M_PI, Vector3d::Random().normalized()).toRotationMatrix();
+        Matrix3d S = Matrix3d::Identity() + 0.2*Matrix3d::Random();
+        B.Aff[i] = pad(S*S.transpose()*R, Vector3d::Random());
+    }
+    B.parametrise(BM_SRL);
+    Vector3d lower = pts[0], upper = pts[0];
+    for(int i=0;i<numPts;i++){
+        lower = lower.cwiseMin(pts[i]);
+        upper = upper.cwiseMax(pts[i]);
+    }
+    double diagonal = (upper-lower).norm();
+    std::printf("%d points, %d probes\n", numPts, numPrb);
+    std::printf("%-8s %12s %8s %14s %14s\n", "storage", "memory(MB)", "saved", "blend(Mpts/s)", "max error");
+
+    const short precisions[] = {WP_DOUBLE, WP_FLOAT, WP_FIXED16};
+    const char* names[] = {"double", "float", "fixed16"};
+    std::vector<Vector3d> reference(numPts), deformed(numPts);
+    size_t doubleBytes = 0;
+    for(int p=0;p<3;p++){
+        // cutoff weights out of the distance table, as the deformer computes them
+        Distance D;
+        D.setNum(numPrb, numPts, 0, precisions[p] != WP_DOUBLE);
+        D.computeDistPts(pts, B.centre);
+        ProbeWeight W;
+        W.setNum(numPts, numPrb, true, precisions[p]);
+        double radius = 0.5 * diagonal;
+#pragma omp parallel for
+        for(int j=0;j<numPts;j++){
+            std::vector<double> w(numPrb);
+            for(int i=0;i<numPrb;i++){
+                double d = D.distPts(i,j);
+                w[i] = d > radius ? 0 : pow((radius-d)/radius, 4);
+            }
+            D.normaliseWeight(NM_LINEAR, w);
+            W.setRow(WC_ROTATION, j, w);
+        }
+        size_t bytes = W.bytes() + D.distPts.bytes() + D.distTet.bytes();
+        if(p == 0) doubleBytes = bytes;
+        // blend as probeDeformer does
+        BlendScratch scratch;
+        scratch.resize(1, numPrb);
+        double start = wallTime();
+#pragma omp parallel for
+        for(int j=0;j<numPts;j++){
+            const std::vector<double>& w = W.row(WC_ROTATION, j, scratch.get(0));
+            Matrix3d S, R;
+            Matrix4d mat = B.blend(BM_SRL, false, w, w, w, S, R);
+            deformed[j] = (pad(pts[j]) * mat).head<3>();
+        }
+        double elapsed = wallTime() - start;
+        if(p == 0) reference = deformed;
+        double error = 0;
+        for(int j=0;j<numPts;j++){
+            error = std::max(error, (deformed[j]-reference[j]).norm() / diagonal);
+        }
+        std::printf("%-8s %12.2f %7.1f%% %14.2f %14.3g\n", names[p], bytes/1048576.0,
+                    100.0*(1.0 - (double)bytes/doubleBytes), numPts/elapsed/1e6, error);
+        CHECK(error < (precisions[p] == WP_FIXED16 ? 1e-3 : 1e-5));
+        CHECK(p == 0 || bytes < doubleBytes);
+    }
+    return 0;
+}
@@ -19,74 +19,39 @@
 #include <iostream>
 #include <cassert>
 #include <vector>
-#include <map>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "deformerConst.h"
 
 
 using namespace Eigen;
 
-// class for a pair of numerics
-template<class T>
-class couple{
+// compact mesh topology; every list is a flat array
+class MeshTopology{
 public:
-    T left, right;
-    couple() {};
-    couple(T l, T r){
-        left = l;
-        right = r;
-    }
-    bool operator==(const couple<T>& pa){
-        return (left == pa.left && right == pa.right);
-    }
-    bool operator<(const couple<T>& pa) const {
-        return ( left<pa.left || (left==pa.left && right<pa.right));
+    std::vector<int> faceList;     // three vertex indices (of Maya) for each triangle
+    std::vector<int> edgeVertex;   // two end points for each inner edge
+    std::vector<int> edgeFace;     // two adjacent faces (indices of faceList) for each inner edge
+    // triangle fan around each vertex: the i-th fan is centred at fanVertex[i] and consists of the triangles
+    // fanVertex[i]-fanTriangle[2k]-fanTriangle[2k+1] for fanOffset[i] <= k < fanOffset[i+1], which are oriented faces
+    std::vector<int> fanVertex, fanOffset, fanTriangle;
+    MeshTopology(): fanOffset(1,0) {};
+    int numFace() const { return (int)faceList.size()/3; }
+    int numEdge() const { return (int)edgeVertex.size()/2; }
+    int numFan() const { return (int)fanVertex.size(); }
+    size_t bytes() const {
+        return (faceList.size() + edgeVertex.size() + edgeFace.size()
+                + fanVertex.size() + fanOffset.size() + fanTriangle.size()) * sizeof(int);
     }
 };
 
-// edge data
-class edge{
+// tet adjacency in compressed rows; the neighbours of the i-th tet are index[offset[i]] to index[offset[i+1]-1]
+class TetAdjacency{
 public:
-    std::vector<int> vertices;
-    std::vector<int> faces;
-    edge(){
-        vertices.resize(2);
-        faces.resize(2);
-    }
-    edge(int s,int t,int f,int g){
-        vertices.resize(2);
-        faces.resize(2);
-        vertices[0]=s;   // vertex index of Maya
-        vertices[1]=t;
-        faces[0]=f;   // adjacent face index of faceList
-        faces[1]=g;
-    }
-    edge &operator=(const edge &e){
-        vertices[0]=e.vertices[0];
-        vertices[1]=e.vertices[1];
-        faces[0]=e.faces[0];
-        faces[1]=e.faces[1];
-        return(*this);
-    }
-};
-
-// vertex data
-class vertex{
-public:
-    int index;  // vertex index of Maya
-    std::vector<int> connectedTriangles; // list of vertex indices. sorted in such a way that index-1-2, index-3-4,..., index-(last-1)-last form oriented faces
-    vertex(){
-        connectedTriangles.clear();
-    }
-    vertex(int idx, std::vector<int> list){
-        index = idx;
-        connectedTriangles=list;
-    }
-    vertex &operator=(const vertex &v){
-        index = v.index;
-        connectedTriangles=v.connectedTriangles;
-        return(*this);
-    }
+    std::vector<int> offset, index;
 };
 
 
@@ -103,39 +68,307 @@ namespace Tetrise{
         return m;
     }
     
+    // number of bits needed to hold the integers up to n
+    int bitWidth(int n){
+        int bits = 1;
+        while( (n >> bits) > 0 ) bits++;
+        return bits;
+    }
+    
+    // stable LSD radix sort of keys of numBits bits, carrying an index along
+    void radixSort(std::vector<unsigned long long>& key, std::vector<int>& val, int numBits){
+        const int RADIX_BITS = 11;
+        const int NUM_BUCKET = 1 << RADIX_BITS;
+        size_t n = key.size();
+        std::vector<unsigned long long> key2(n);
+        std::vector<int> val2(n);
+#ifdef _OPENMP
+        int maxThread = omp_get_max_threads();
+#else
+        int maxThread = 1;
+#endif
+        std::vector<size_t> count((size_t)maxThread*NUM_BUCKET);
+        for(int shift=0; shift<numBits; shift+=RADIX_BITS){
+            std::fill(count.begin(), count.end(), 0);
+#pragma omp parallel num_threads(maxThread)
+            {
+#ifdef _OPENMP
+                int th = omp_get_thread_num(), numThread = omp_get_num_threads();
+#else
+                int th = 0, numThread = 1;
+#endif
+                // each thread takes a contiguous chunk so that the order of equal digits is kept
+                size_t begin = n*th/numThread, end = n*(th+1)/numThread;
+                size_t* c = &count[(size_t)th*NUM_BUCKET];
+                for(size_t i=begin;i<end;i++){
+                    c[(key[i] >> shift) & (NUM_BUCKET-1)]++;
+                }
+#pragma omp barrier
+#pragma omp single
+                {
+                    size_t sum = 0;
+                    for(int d=0;d<NUM_BUCKET;d++){
+                        for(int t=0;t<numThread;t++){
+                            size_t x = count[(size_t)t*NUM_BUCKET+d];
+                            count[(size_t)t*NUM_BUCKET+d] = sum;
+                            sum += x;
+                        }
+                    }
+                }
+                for(size_t i=begin;i<end;i++){
+                    size_t pos = c[(key[i] >> shift) & (NUM_BUCKET-1)]++;
+                    key2[pos] = key[i];
+                    val2[pos] = val[i];
+                }
+            }
+            key.swap(key2);
+            val.swap(val2);
+        }
+    }
+    
+    // for each key, the position of its first occurrence in the list, or -1 if it is the first one.
+    // The result is the same as scanning the list with a map.
+    void findFirstOccurrence(const std::vector<unsigned long long>& key, int numBits, std::vector<int>& first){
+        int n = (int)key.size();
+        std::vector<unsigned long long> sorted(key);
+        std::vector<int> pos(n);
+#pragma omp parallel for
+        for(int k=0;k<n;k++){
+            pos[k] = k;
+        }
+        radixSort(sorted, pos, numBits);
+        first.assign(n, -1);
+        int start = 0;
+        for(int k=1;k<n;k++){
+            if(sorted[k] != sorted[start]){
+                start = k;
+            }else{
+                first[pos[k]] = pos[start];
+            }
+        }
+    }
+    
+    // compressed rows out of (row, column) pairs; the order of the pairs is kept in each row
+    void makeCompressedRows(int numRow, const std::vector<int>& pairs, std::vector<int>& offset, std::vector<int>& index){
+        int numPairs = (int)pairs.size()/2;
+        offset.assign(numRow+1, 0);
+        for(int k=0;k<numPairs;k++){
+            offset[pairs[2*k]+1]++;
+        }
+        for(int i=0;i<numRow;i++){
+            offset[i+1] += offset[i];
+        }
+        index.resize(numPairs);
+        std::vector<int> cur(offset.begin(), offset.end()-1);
+        for(int k=0;k<numPairs;k++){
+            index[cur[pairs[2*k]]++] = pairs[2*k+1];
+        }
+    }
+    
+    // compare vertices by degree
+    struct DegreeLess {
+        const std::vector<int>& degree;
+        DegreeLess(const std::vector<int>& _degree): degree(_degree) {};
+        bool operator()(int a, int b) const { return degree[a] < degree[b]; }
+    };
+    
     // make the list of (inner) edges
-    int makeEdgeList(const std::vector<int>& faceList, std::vector<edge>& edgeList){
-        edgeList.clear();
-        edgeList.reserve(faceList.size());
-        std::map< couple<int>, int > edges;
-        int s,t;
-        for(int i=0;i<faceList.size()/3;i++){
-            for(int j=0;j<3;j++){
-                s=faceList[3*i+j];
-                t=faceList[3*i+((j+1)%3)];
-                if(s>t) swap(s,t);
-                couple<int> pa(s,t);
-                if( edges.find(pa) == edges.end() ){  // if not in the list
-                    edges[pa] = i;
-                }else{
-                    edge newEdge(s,t,edges[pa],i);
-                    edgeList.push_back(newEdge);
+    int makeEdgeList(MeshTopology& topo){
+        const std::vector<int>& faceList = topo.faceList;
+        int numHalfEdge = 3*topo.numFace();
+        int maxIndex = 0;
+        for(int h=0;h<numHalfEdge;h++){
+            maxIndex = std::max(maxIndex, faceList[h]);
+        }
+        int bits = bitWidth(maxIndex);
+        // half-edges are keyed by their sorted end points
+        std::vector<unsigned long long> key(numHalfEdge);
+#pragma omp parallel for
+        for(int h=0;h<numHalfEdge;h++){
+            unsigned long long s=faceList[h];
+            unsigned long long t=faceList[3*(h/3)+((h%3+1)%3)];
+            if(s>t) std::swap(s,t);
+            key[h] = (s << bits) | t;
+        }
+        std::vector<int> first;
+        findFirstOccurrence(key, 2*bits, first);
+        // an edge is made whenever a half-edge meets an earlier one
+        std::vector<int> offset(numHalfEdge+1, 0);
+        for(int h=0;h<numHalfEdge;h++){
+            offset[h+1] = offset[h] + (first[h]>=0 ? 1 : 0);
+        }
+        int numEdge = offset[numHalfEdge];
+        topo.edgeVertex.resize(2*numEdge);
+        topo.edgeFace.resize(2*numEdge);
+#pragma omp parallel for
+        for(int h=0;h<numHalfEdge;h++){
+            if(first[h]>=0){
+                int s=faceList[h];
+                int t=faceList[3*(h/3)+((h%3+1)%3)];
+                if(s>t) std::swap(s,t);
+                int e = offset[h];
+                topo.edgeVertex[2*e] = s;   // vertex index of Maya
+                topo.edgeVertex[2*e+1] = t;
+                topo.edgeFace[2*e] = first[h]/3;   // adjacent face index of faceList
+                topo.edgeFace[2*e+1] = h/3;
+            }
+        }
+        return numEdge;
+    }
+    
+    // ordering of vertices for locality (VO_*); newIndex[i] is the new index of the i-th vertex
+    void makeVertexOrdering(short orderingMode, const std::vector<Vector3d>& pts, const MeshTopology& topo,
+                            std::vector<int>& newIndex){
+        int numPts = (int)pts.size();
+        newIndex.resize(numPts);
+        if(orderingMode == VO_MORTON){
+            // sort along the Morton curve of the bounding box quantised to 21 bits per axis
+            Vector3d lo = Vector3d::Constant(HUGE_VAL), hi = -lo;
+            for(int i=0;i<numPts;i++){
+                lo = lo.cwiseMin(pts[i]);
+                hi = hi.cwiseMax(pts[i]);
+            }
+            Vector3d scale = ((1<<21)-1) * (hi-lo).cwiseMax(EPSILON).cwiseInverse();
+            std::vector<unsigned long long> key(numPts);
+            std::vector<int> order(numPts);
+#pragma omp parallel for
+            for(int i=0;i<numPts;i++){
+                unsigned long long code = 0;
+                for(int a=0;a<3;a++){
+                    unsigned long long q = (unsigned long long)((pts[i][a]-lo[a])*scale[a]);
+                    for(int b=0;b<21;b++){
+                        code |= ((q >> b) & 1ULL) << (3*b+a);
+                    }
+                }
+                key[i] = code;
+                order[i] = i;
+            }
+            radixSort(key, order, 63);
+            for(int k=0;k<numPts;k++){
+                newIndex[order[k]] = k;
+            }
+        }else if(orderingMode == VO_RCM){
+            // vertex adjacency out of the triangles
+            int numFace = topo.numFace();
+            std::vector<int> pairs(12*numFace);
+            for(int f=0;f<numFace;f++){
+                for(int j=0;j<3;j++){
+                    int s = topo.faceList[3*f+j], t = topo.faceList[3*f+(j+1)%3];
+                    pairs[12*f+4*j] = s;
+                    pairs[12*f+4*j+1] = t;
+                    pairs[12*f+4*j+2] = t;
+                    pairs[12*f+4*j+3] = s;
                 }
             }
+            std::vector<int> offset, index;
+            makeCompressedRows(numPts, pairs, offset, index);
+            std::vector<int> degree(numPts);
+            for(int i=0;i<numPts;i++){
+                degree[i] = offset[i+1]-offset[i];
+            }
+            // Cuthill-McKee: breadth first search from the vertex of the smallest degree in each component,
+            // visiting neighbours in the order of degree
+            std::vector<int> byDegree(numPts);
+            for(int i=0;i<numPts;i++){
+                byDegree[i] = i;
+            }
+            std::stable_sort(byDegree.begin(), byDegree.end(), DegreeLess(degree));
+            std::vector<int> order;
+            order.reserve(numPts);
+            std::vector<bool> isVisited(numPts, false);
+            std::vector<int> nbr;
+            for(int r=0;r<numPts;r++){
+                if(isVisited[byDegree[r]]) continue;
+                isVisited[byDegree[r]] = true;
+                order.push_back(byDegree[r]);
+                for(size_t head=order.size()-1; head<order.size(); head++){
+                    int v = order[head];
+                    nbr.clear();
+                    for(int k=offset[v];k<offset[v+1];k++){
+                        if(!isVisited[index[k]]){
+                            isVisited[index[k]] = true;
+                            nbr.push_back(index[k]);
+                        }
+                    }
+                    std::stable_sort(nbr.begin(), nbr.end(), DegreeLess(degree));
+                    order.insert(order.end(), nbr.begin(), nbr.end());
+                }
+            }
+            // reversed
+            for(int k=0;k<numPts;k++){
+                newIndex[order[k]] = numPts-1-k;
+            }
+        }else{
+            for(int i=0;i<numPts;i++){
+                newIndex[i] = i;
+            }
         }
-        return (int)edgeList.size();
+    }
+    
+    // relabel the vertices of the topology by newIndex, and sort the faces and the fans along the new order
+    // so that the tets made out of them follow it
+    void permuteTopology(const std::vector<int>& newIndex, MeshTopology& topo){
+        int numPts = (int)newIndex.size();
+        int numFace = topo.numFace();
+        int numFan = topo.numFan();
+        for(size_t k=0;k<topo.faceList.size();k++){
+            topo.faceList[k] = newIndex[topo.faceList[k]];
+        }
+        for(int i=0;i<numFan;i++){
+            topo.fanVertex[i] = newIndex[topo.fanVertex[i]];
+        }
+        for(size_t k=0;k<topo.fanTriangle.size();k++){
+            topo.fanTriangle[k] = newIndex[topo.fanTriangle[k]];
+        }
+        int bits = bitWidth(numPts);
+        // faces by their smallest vertex
+        std::vector<unsigned long long> key(numFace);
+        std::vector<int> order(numFace);
+        for(int f=0;f<numFace;f++){
+            key[f] = std::min(topo.faceList[3*f], std::min(topo.faceList[3*f+1], topo.faceList[3*f+2]));
+            order[f] = f;
+        }
+        radixSort(key, order, bits);
+        std::vector<int> faceList(3*numFace);
+        for(int f=0;f<numFace;f++){
+            for(int j=0;j<3;j++){
+                faceList[3*f+j] = topo.faceList[3*order[f]+j];
+            }
+        }
+        topo.faceList.swap(faceList);
+        // fans by their centre
+        key.resize(numFan);
+        order.resize(numFan);
+        for(int i=0;i<numFan;i++){
+            key[i] = topo.fanVertex[i];
+            order[i] = i;
+        }
+        radixSort(key, order, bits);
+        std::vector<int> fanVertex(numFan), fanOffset(numFan+1, 0), fanTriangle(topo.fanTriangle.size());
+        for(int i=0;i<numFan;i++){
+            int g = order[i];
+            fanVertex[i] = topo.fanVertex[g];
+            fanOffset[i+1] = fanOffset[i] + topo.fanOffset[g+1] - topo.fanOffset[g];
+            for(int k=2*topo.fanOffset[g], l=2*fanOffset[i]; k<2*topo.fanOffset[g+1]; k++, l++){
+                fanTriangle[l] = topo.fanTriangle[k];
+            }
+        }
+        topo.fanVertex.swap(fanVertex);
+        topo.fanOffset.swap(fanOffset);
+        topo.fanTriangle.swap(fanTriangle);
+        // edges follow the faces
+        makeEdgeList(topo);
     }
     
     // make the list of tetrahedra
-    int makeTetList(short tetMode, int numPts, const std::vector<int>& faceList,
-                    const std::vector<edge>& edgeList, const std::vector<vertex>& vertexList,
-                    std::vector<int>& tetList){
-        tetList.clear();
+    int makeTetList(short tetMode, int numPts, const MeshTopology& topo, std::vector<int>& tetList){
+        const std::vector<int>& faceList = topo.faceList;
         int dim=0;    // number of total points including ghost ones
         if(tetMode == TM_FACE){
-            int numTet = (int)faceList.size()/3;
+            int numTet = topo.numFace();
             dim = numTet + numPts;
             tetList.resize(4*numTet);
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 tetList[4*i] = faceList[3*i];
                 tetList[4*i+1] = faceList[3*i+1];
@@ -143,15 +376,16 @@ namespace Tetrise{
                 tetList[4*i+3] = i+numPts;
             }
         }else if(tetMode == TM_EDGE){
-            int numTet = 2 * (int)edgeList.size();
-            dim = numPts + (int)edgeList.size();
-            tetList.resize(4* numTet);
-            for(int i=0;i<edgeList.size();i++){
+            int numEdge = topo.numEdge();
+            dim = numPts + numEdge;
+            tetList.resize(8*numEdge);
+#pragma omp parallel for
+            for(int i=0;i<numEdge;i++){
                 for(int j=0;j<2;j++){
-                    int f=edgeList[i].faces[j];
+                    int f=topo.edgeFace[2*i+j];
                     int k=0;
-                    while(faceList[3*f+k]==edgeList[i].vertices[0]  // first two vertices should be the edge
-                          || faceList[3*f+k]==edgeList[i].vertices[1]){
+                    while(faceList[3*f+k]==topo.edgeVertex[2*i]  // first two vertices should be the edge
+                          || faceList[3*f+k]==topo.edgeVertex[2*i+1]){
                         k++;
                     }
                     assert(k<3);
@@ -161,52 +395,44 @@ namespace Tetrise{
                     tetList[8*i + 4*j+3]=i+numPts;
                 }
             }
-        }else if(tetMode == TM_VERTEX){
-            tetList.reserve(faceList.size());
-            dim = numPts + (int)vertexList.size();
-            for(int i=0;i<vertexList.size();i++){
-                for(int j=0;j<vertexList[i].connectedTriangles.size()/2;j++){
-                    tetList.push_back(vertexList[i].index);   // the first vertex should be the vertex
-                    tetList.push_back(vertexList[i].connectedTriangles[2*j]);
-                    tetList.push_back(vertexList[i].connectedTriangles[2*j+1]);
-                    tetList.push_back(numPts+i);
-                }
-            }
-        }else if(tetMode == TM_VFACE){
-            tetList.reserve(faceList.size());
-            int cur=0;
-            for(int i=0;i<vertexList.size();i++){
-                for(int j=0;j<vertexList[i].connectedTriangles.size()/2;j++){
-                    tetList.push_back(vertexList[i].index);   // the first vertex should be the vertex
-                    tetList.push_back(vertexList[i].connectedTriangles[2*j]);
-                    tetList.push_back(vertexList[i].connectedTriangles[2*j+1]);
-                    tetList.push_back(numPts+cur);
-                    cur++;
+        }else if(tetMode == TM_VERTEX || tetMode == TM_VFACE){
+            int numFan = topo.numFan();
+            int numTet = topo.fanOffset[numFan];
+            tetList.resize(4*numTet);
+#pragma omp parallel for
+            for(int i=0;i<numFan;i++){
+                for(int k=topo.fanOffset[i];k<topo.fanOffset[i+1];k++){
+                    tetList[4*k] = topo.fanVertex[i];   // the first vertex should be the vertex
+                    tetList[4*k+1] = topo.fanTriangle[2*k];
+                    tetList[4*k+2] = topo.fanTriangle[2*k+1];
+                    tetList[4*k+3] = numPts + (tetMode == TM_VERTEX ? i : k);
                 }
             }
-            dim = numPts + (int) tetList.size()/4;
+            dim = numPts + (tetMode == TM_VERTEX ? numFan : numTet);
         }
         return dim;
     }
     
     // comptute tetrahedra weights from those of points
     void makeTetWeightList(short tetMode, const std::vector<int>& tetList,
-                   const std::vector<int>& faceList, const std::vector<edge>& edgeList,
-                   const std::vector<vertex>& vertexList, const VectorXd& ptsWeight,
+                   const MeshTopology& topo, const VectorXd& ptsWeight,
                    std::vector<double>& tetWeight ){
         int numTet = (int)tetList.size()/4;
         tetWeight.resize(numTet);
         if(tetMode == TM_FACE){
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 tetWeight[i] = (ptsWeight[tetList[4*i]] + ptsWeight[tetList[4*i+1]]
                                 + ptsWeight[tetList[4*i+2]])/3;
             }
         }else if(tetMode == TM_EDGE){
-            for(int i=0;i<edgeList.size();i++){
-                tetWeight[2*i]= (ptsWeight[edgeList[i].vertices[0]]+ptsWeight[edgeList[i].vertices[1]])/2.0;
-                tetWeight[2*i+1]= (ptsWeight[edgeList[i].vertices[0]]+ptsWeight[edgeList[i].vertices[1]])/2.0;
+#pragma omp parallel for
+            for(int i=0;i<topo.numEdge();i++){
+                tetWeight[2*i]= (ptsWeight[topo.edgeVertex[2*i]]+ptsWeight[topo.edgeVertex[2*i+1]])/2.0;
+                tetWeight[2*i+1]= tetWeight[2*i];
             }
         }else if(tetMode == TM_VERTEX || tetMode == TM_VFACE){
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 tetWeight[i] = ptsWeight[tetList[4*i]];
             }
@@ -214,8 +440,7 @@ namespace Tetrise{
     }
     // comptute tetrahedra weights from those of points
     void makePtsWeightList(short tetMode, int numPts, const std::vector<int>& tetList,
-                        const std::vector<int>& faceList, const std::vector<edge>& edgeList,
-                        const std::vector<vertex>& vertexList, const std::vector<double>& tetWeight,
+                        const MeshTopology& topo, const std::vector<double>& tetWeight,
                         std::vector<double>& ptsWeight ){
         int numTet = (int)tetList.size()/4;
         ptsWeight.clear();
@@ -229,18 +454,23 @@ namespace Tetrise{
                 }
             }
         }else if(tetMode == TM_EDGE){
-            for(int i=0;i<edgeList.size();i++){
-                ptsWeight[edgeList[i].vertices[0]] += tetWeight[2*i]+tetWeight[2*i+1];
-                ptsWeight[edgeList[i].vertices[1]] += tetWeight[2*i]+tetWeight[2*i+1];
-                ptsCount[edgeList[i].vertices[0]]++;
-                ptsCount[edgeList[i].vertices[1]]++;
+            for(int i=0;i<topo.numEdge();i++){
+                for(int j=0;j<2;j++){
+                    ptsWeight[topo.edgeVertex[2*i+j]] += tetWeight[2*i]+tetWeight[2*i+1];
+                    ptsCount[topo.edgeVertex[2*i+j]]++;
+                }
             }
         }else if(tetMode == TM_VERTEX || tetMode == TM_VFACE){
-            for(int i=0;i<numTet;i++){
-                ptsWeight[tetList[4*i]] += tetWeight[i];
-                ptsCount[tetList[4*i]]++;
+            // the tets around a vertex are consecutive, so each vertex gathers its own
+#pragma omp parallel for
+            for(int i=0;i<topo.numFan();i++){
+                for(int k=topo.fanOffset[i];k<topo.fanOffset[i+1];k++){
+                    ptsWeight[topo.fanVertex[i]] += tetWeight[k];
+                }
+                ptsCount[topo.fanVertex[i]] += topo.fanOffset[i+1]-topo.fanOffset[i];
             }
         }
+#pragma omp parallel for
         for(int i=0;i<numPts;i++){
             ptsWeight[i] /= ptsCount[i];
         }
@@ -248,43 +478,40 @@ namespace Tetrise{
 
 
     
-        // construct tetrahedra matrices
+    // construct tetrahedra matrices
     void makeTetMatrix(short tetMode, const std::vector<Vector3d>& pts, const std::vector<int>& tetList,
-        const std::vector<int>& faceList, const std::vector<edge>& edgeList,
-                    const std::vector<vertex>& vertexList, std::vector<Matrix4d>& P, std::vector<double>& tetWeight, bool normalise=false){
-        Vector3d u, v, q, c;
+                    const MeshTopology& topo, std::vector<Matrix4d>& P, std::vector<double>& tetWeight, bool normalise=false){
         int numTet = (int)tetList.size()/4;
-        P.clear();
-        P.reserve(numTet);
-        tetWeight.clear();
-        tetWeight.reserve(numTet);
+        P.resize(numTet);
+        tetWeight.resize(numTet);
         if(tetMode == TM_FACE){
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 Vector3d p0=pts[tetList[4*i]];
                 Vector3d p1=pts[tetList[4*i+1]];
                 Vector3d p2=pts[tetList[4*i+2]];
-                q = (p1-p0).cross(p2-p0);
-                tetWeight.push_back(q.norm()/2);
+                Vector3d q = (p1-p0).cross(p2-p0);
+                tetWeight[i] = q.norm()/2;
                 if(normalise){
                     q.normalize();
                 }else{
                     q = (q/sqrt(q.norm()));
                 }
-                c = q +(p0+p1+p2)/3;
-                P.push_back(mat(p0,p1,p2,c));
+                Vector3d c = q +(p0+p1+p2)/3;
+                P[i] = mat(p0,p1,p2,c);
             }
         }else if(tetMode == TM_EDGE){
-            for(int i=0;i<edgeList.size();i++){
-                c = Vector3d::Zero();
+#pragma omp parallel for
+            for(int i=0;i<topo.numEdge();i++){
+                Vector3d c = Vector3d::Zero();
                 for(int j=0;j<2;j++){
                     Vector3d p0=pts[tetList[8*i + 4*j]];
                     Vector3d p1=pts[tetList[8*i + 4*j + 1]];
                     Vector3d p2=pts[tetList[8*i + 4*j + 2]];
-                    q=(p1-p0).cross(p2-p0).normalized();
-                    c += q;
+                    c += (p1-p0).cross(p2-p0).normalized();
                 }
-                u = pts[edgeList[i].vertices[0]];
-                v = pts[edgeList[i].vertices[1]];
+                Vector3d u = pts[topo.edgeVertex[2*i]];
+                Vector3d v = pts[topo.edgeVertex[2*i+1]];
                 if(normalise){
                     c = (u+v)/2 + c.normalized();
                 }else{
@@ -294,21 +521,22 @@ namespace Tetrise{
                     Vector3d p0=pts[tetList[8*i + 4*j]];
                     Vector3d p1=pts[tetList[8*i + 4*j + 1]];
                     Vector3d p2=pts[tetList[8*i + 4*j + 2]];
-                    P.push_back(mat(p0,p1,p2,c));
-                    tetWeight.push_back((p0-p1).norm());
+                    P[2*i+j] = mat(p0,p1,p2,c);
+                    tetWeight[2*i+j] = (p0-p1).norm();
                 }
             }
         }else if(tetMode == TM_VERTEX){
-            for(int i=0;i<vertexList.size();i++){
-                c = Vector3d::Zero();
-                Vector3d p0 = pts[vertexList[i].index];
+#pragma omp parallel for
+            for(int i=0;i<topo.numFan();i++){
+                Vector3d c = Vector3d::Zero();
+                Vector3d p0 = pts[topo.fanVertex[i]];
                 Vector3d p1,p2;
                 double area = 0;
-                for(int j=0;j<vertexList[i].connectedTriangles.size()/2;j++){
-                    p1 = pts[vertexList[i].connectedTriangles[2*j]];
-                    p2 = pts[vertexList[i].connectedTriangles[2*j+1]];
-                    q = (p1-p0).cross(p2-p0);
-                    tetWeight.push_back(q.norm()/2);
+                for(int k=topo.fanOffset[i];k<topo.fanOffset[i+1];k++){
+                    p1 = pts[topo.fanTriangle[2*k]];
+                    p2 = pts[topo.fanTriangle[2*k+1]];
+                    Vector3d q = (p1-p0).cross(p2-p0);
+                    tetWeight[k] = q.norm()/2;
                     area += q.norm()/2;
                     c += q.normalized();
                 }
@@ -317,27 +545,29 @@ namespace Tetrise{
                 }else{
                     c = p0 + sqrt(area)*(c.normalized());
                 }
-                for(int j=0;j<vertexList[i].connectedTriangles.size()/2;j++){
-                    p1 = pts[vertexList[i].connectedTriangles[2*j]];
-                    p2 = pts[vertexList[i].connectedTriangles[2*j+1]];
-                    P.push_back( mat(p0,p1,p2,c));
+                for(int k=topo.fanOffset[i];k<topo.fanOffset[i+1];k++){
+                    p1 = pts[topo.fanTriangle[2*k]];
+                    p2 = pts[topo.fanTriangle[2*k+1]];
+                    P[k] = mat(p0,p1,p2,c);
                 }
             }
         }else if(tetMode == TM_VFACE){
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 Vector3d p0=pts[tetList[4*i]];
                 Vector3d p1=pts[tetList[4*i+1]];
                 Vector3d p2=pts[tetList[4*i+2]];
-                u=(p1-p0).normalized();
-                v=(p2-p0).normalized();
-                q=u.cross(v);
+                Vector3d u=(p1-p0).normalized();
+                Vector3d v=(p2-p0).normalized();
+                Vector3d q=u.cross(v);
+                Vector3d c;
                 if(normalise){
                     c = p0+q.normalized();
                 }else{
                     c = p0+q;
                 }
-                tetWeight.push_back(q.norm()/2);
-                P.push_back(mat(p0,p1,p2,c));
+                tetWeight[i] = q.norm()/2;
+                P[i] = mat(p0,p1,p2,c);
             }
         }
     }
@@ -345,127 +575,160 @@ namespace Tetrise{
     
     // make tetrahedra adjacency list
     void makeAdjacencyList(short tetMode, const std::vector<int>& tetList,
-            const std::vector<edge>& edgeList, const std::vector<vertex>& vertexList,
-                           std::vector< std::vector<int> >& adjacencyList){
-        adjacencyList.resize(tetList.size()/4);
-        for(int i=0;i<adjacencyList.size();i++){
-            adjacencyList[i].clear();
-        }
+            const MeshTopology& topo, TetAdjacency& adjacency){
+        int numTet = (int)tetList.size()/4;
+        std::vector<int> pairs;   // (tet, neighbour) in the order they are found
         if(tetMode == TM_FACE){
-            for(int i=0;i<edgeList.size();i++){
-                adjacencyList[edgeList[i].faces[0]].push_back(edgeList[i].faces[1]);
-                adjacencyList[edgeList[i].faces[1]].push_back(edgeList[i].faces[0]);
+            pairs.reserve(4*topo.numEdge());
+            for(int i=0;i<topo.numEdge();i++){
+                int f0 = topo.edgeFace[2*i], f1 = topo.edgeFace[2*i+1];
+                pairs.push_back(f0); pairs.push_back(f1);
+                pairs.push_back(f1); pairs.push_back(f0);
             }
         }else if(tetMode == TM_EDGE){
-            std::vector< std::vector<int> > faceShareList(2*edgeList.size());
-            for(int i=0;i<2*edgeList.size();i++){
-                faceShareList[i].clear();
-            }
-            for(int i=0;i<edgeList.size();i++){
-                adjacencyList[2*i].push_back(2*i+1);
-                adjacencyList[2*i+1].push_back(2*i);
-                for(int j=0;j<faceShareList[edgeList[i].faces[0]].size();j++){
-                    adjacencyList[2*i].push_back(faceShareList[edgeList[i].faces[0]][j]);
-                    adjacencyList[faceShareList[edgeList[i].faces[0]][j]].push_back(2*i);
-                }
-                for(int j=0;j<faceShareList[edgeList[i].faces[1]].size();j++){
-                    adjacencyList[2*i+1].push_back(faceShareList[edgeList[i].faces[1]][j]);
-                    adjacencyList[faceShareList[edgeList[i].faces[1]][j]].push_back(2*i+1);
+            // tets seen so far on each face
+            std::vector< std::vector<int> > faceShareList(2*topo.numEdge());
+            for(int i=0;i<topo.numEdge();i++){
+                pairs.push_back(2*i); pairs.push_back(2*i+1);
+                pairs.push_back(2*i+1); pairs.push_back(2*i);
+                for(int l=0;l<2;l++){
+                    const std::vector<int>& share = faceShareList[topo.edgeFace[2*i+l]];
+                    for(int j=0;j<(int)share.size();j++){
+                        pairs.push_back(2*i+l); pairs.push_back(share[j]);
+                        pairs.push_back(share[j]); pairs.push_back(2*i+l);
+                    }
                 }
-                faceShareList[edgeList[i].faces[0]].push_back(2*i);
-                faceShareList[edgeList[i].faces[1]].push_back(2*i+1);
+                faceShareList[topo.edgeFace[2*i]].push_back(2*i);
+                faceShareList[topo.edgeFace[2*i+1]].push_back(2*i+1);
             }
         }else if(tetMode == TM_VERTEX || tetMode == TM_VFACE){
-            std::map< couple<int>, int > edges;
-            int s,t,cur=0;
-            for(int i=0;i<vertexList.size();i++){
-                std::vector<int> adj(vertexList[i].connectedTriangles.size()/2);
-                for(int j=0;j<vertexList[i].connectedTriangles.size()/2;j++){
-                    adj[j] = cur+j;
+            // the shared edges are looked up as directed pairs (vertex, s) and (t, vertex) of each tet
+            const std::vector<int>& offset = topo.fanOffset;
+            int numFan = topo.numFan();
+            int maxIndex = 0;
+            for(int i=0;i<(int)tetList.size();i++){
+                maxIndex = std::max(maxIndex, tetList[i]);
+            }
+            int bits = bitWidth(maxIndex);
+            std::vector<unsigned long long> key(2*offset[numFan]);
+#pragma omp parallel for
+            for(int i=0;i<numFan;i++){
+                unsigned long long v = topo.fanVertex[i];
+                for(int k=offset[i];k<offset[i+1];k++){
+                    unsigned long long s=topo.fanTriangle[2*k];
+                    unsigned long long t=topo.fanTriangle[2*k+1];
+                    key[2*k] = (v << bits) | s;
+                    key[2*k+1] = (t << bits) | v;
                 }
-                for(int j=0;j<vertexList[i].connectedTriangles.size()/2;j++){
-                    adjacencyList[cur].insert(adjacencyList[cur].end(), adj.begin(), adj.end());
-                    // list of shared edges
-                    s=vertexList[i].connectedTriangles[2*j];
-                    t=vertexList[i].connectedTriangles[2*j+1];
-                    couple<int> pa1(vertexList[i].index,s),pa2(t,vertexList[i].index);
-                    if( edges.find(pa1) == edges.end() ){  // if not in the list
-                        edges[pa1] = cur;
-                    }else{
-                        adjacencyList[cur].push_back(edges[pa1]);
-                        adjacencyList[edges[pa1]].push_back(cur);
+            }
+            std::vector<int> first;
+            findFirstOccurrence(key, 2*bits, first);
+            for(int i=0;i<numFan;i++){
+                for(int cur=offset[i];cur<offset[i+1];cur++){
+                    for(int k=offset[i];k<offset[i+1];k++){
+                        pairs.push_back(cur); pairs.push_back(k);
                     }
-                    if( edges.find(pa2) == edges.end() ){  // if not in the list
-                        edges[pa2] = cur;
-                    }else{
-                        adjacencyList[cur].push_back(edges[pa2]);
-                        adjacencyList[edges[pa2]].push_back(cur);
+                    for(int l=0;l<2;l++){
+                        int f = first[2*cur+l];
+                        if(f>=0){
+                            pairs.push_back(cur); pairs.push_back(f/2);
+                            pairs.push_back(f/2); pairs.push_back(cur);
+                        }
                     }
-                    cur++;
                 }
             }
         }
+        makeCompressedRows(numTet, pairs, adjacency.offset, adjacency.index);
     }
 
-    // get rid of degenerate tetrahedra
-    int removeDegenerate(short tetMode, int numPts,
-           std::vector<int>& tetList,  std::vector<int>& faceList, std::vector<edge>& edgeList,
-                         std::vector<vertex>& vertexList, const std::vector<Matrix4d>& P){
+    // get rid of degenerate tetrahedra.
+    // P and tetWeight are compacted along with the topology, so they need not be constructed again.
+    int removeDegenerate(short tetMode, int numPts, std::vector<int>& tetList, MeshTopology& topo,
+                         std::vector<Matrix4d>& P, std::vector<double>& tetWeight){
+        int numTet = (int)tetList.size()/4;
+        // the determinant of P reduces to the triple product of the edge vectors from the first vertex
+        std::vector<char> isGoodTet(numTet);
+#pragma omp parallel for
+        for(int i=0;i<numTet;i++){
+            RowVector3d p0 = P[i].block<1,3>(0,0);
+            RowVector3d a = P[i].block<1,3>(1,0)-p0, b = P[i].block<1,3>(2,0)-p0, c = P[i].block<1,3>(3,0)-p0;
+            isGoodTet[i] = abs(a.cross(b).dot(c))>EPSILON;
+        }
+        // tets are removed in groups: a face, an edge, or a vertex depending on tetMode
+        std::vector<int> groupOffset;
         if (tetMode == TM_FACE){
-            std::vector<int> goodList(0);
-            std::vector<int> oldFaceList = faceList;
-            int numTet = (int)tetList.size()/4;
-            for(int i=0;i<numTet;i++){
-                if( abs(P[i].determinant())>EPSILON){
-                    goodList.push_back(i);
+            groupOffset.resize(numTet+1);
+            for(int i=0;i<=numTet;i++) groupOffset[i] = i;
+        }else if( tetMode == TM_EDGE){
+            groupOffset.resize(topo.numEdge()+1);
+            for(int i=0;i<=topo.numEdge();i++) groupOffset[i] = 2*i;
+        }else if( tetMode == TM_VERTEX || tetMode == TM_VFACE){
+            groupOffset = topo.fanOffset;
+        }
+        std::vector<int> goodList(0);
+        std::vector<int> newOffset(1,0);
+        for(int g=0;g+1<(int)groupOffset.size();g++){
+            bool isGood = true;
+            for(int k=groupOffset[g];k<groupOffset[g+1];k++){
+                isGood = isGood && isGoodTet[k];
+            }
+            if(isGood){
+                goodList.push_back(g);
+                newOffset.push_back(newOffset.back() + groupOffset[g+1]-groupOffset[g]);
+            }
+        }
+        int numGood = (int)goodList.size();
+        if(numGood == (int)groupOffset.size()-1){
+            return makeTetList(tetMode, numPts, topo, tetList);
+        }
+        // compact the matrices and the weights
+        std::vector<Matrix4d> newP(newOffset[numGood], Matrix4d::Zero());
+        std::vector<double> newTetWeight((int)tetWeight.size() == numTet ? newOffset[numGood] : 0);
+#pragma omp parallel for
+        for(int k=0;k<numGood;k++){
+            int g = goodList[k];
+            for(int l=0;l<groupOffset[g+1]-groupOffset[g];l++){
+                newP[newOffset[k]+l] = P[groupOffset[g]+l];
+                if(!newTetWeight.empty()){
+                    newTetWeight[newOffset[k]+l] = tetWeight[groupOffset[g]+l];
                 }
             }
-            int numFaces = (int)goodList.size();
-            faceList.resize(3*numFaces);
-            for(int i=0;i<numFaces;i++){
-                faceList[3*i] = oldFaceList[3*goodList[i]];
-                faceList[3*i+1] = oldFaceList[3*goodList[i]+1];
-                faceList[3*i+2] = oldFaceList[3*goodList[i]+2];
+        }
+        P.swap(newP);
+        if((int)tetWeight.size() == numTet){
+            tetWeight.swap(newTetWeight);
+        }
+        // compact the topology
+        if (tetMode == TM_FACE){
+            for(int i=0;i<numGood;i++){
+                for(int j=0;j<3;j++){
+                    topo.faceList[3*i+j] = topo.faceList[3*goodList[i]+j];
+                }
             }
-            makeEdgeList(faceList, edgeList);
+            topo.faceList.resize(3*numGood);
+            makeEdgeList(topo);
         }else if( tetMode == TM_EDGE){
-            // deep copy edgeList
-            std::vector<edge> oldEdgeList(edgeList.size());
-            std::copy(edgeList.begin(), edgeList.end(), oldEdgeList.begin() );
-            // enumerate good edges
-            std::vector<int> goodList(0);
-            int numEdges = (int)edgeList.size();
-            for(int i=0;i<numEdges;i++){
-                if( abs(P[2*i].determinant())>EPSILON && abs(P[2*i+1].determinant())>EPSILON){
-                    goodList.push_back(i);
+            for(int i=0;i<numGood;i++){
+                for(int j=0;j<2;j++){
+                    topo.edgeVertex[2*i+j] = topo.edgeVertex[2*goodList[i]+j];
+                    topo.edgeFace[2*i+j] = topo.edgeFace[2*goodList[i]+j];
                 }
             }
-            numEdges = (int)goodList.size();
-            edgeList.resize(numEdges);
-            for(int i=0;i<numEdges;i++){
-                edgeList[i]=oldEdgeList[goodList[i]];
-            }
+            topo.edgeVertex.resize(2*numGood);
+            topo.edgeFace.resize(2*numGood);
         }else if( tetMode == TM_VERTEX || tetMode == TM_VFACE){
-            // deep copy edgeList
-            std::vector<vertex> oldVertexList(vertexList.size());
-            std::copy(vertexList.begin(), vertexList.end(), oldVertexList.begin());
-            // enumerate good edges
-            std::vector<int> goodList(0);
-            int cur = 0;
-            for(int i=0;i<vertexList.size();i++){
-                bool isGood = true;
-                for(int j=0;j<vertexList[i].connectedTriangles.size()/2;j++){
-                    isGood = isGood && abs(P[cur].determinant())>EPSILON;
-                    cur++;
+            for(int i=0;i<numGood;i++){
+                int g = goodList[i];
+                topo.fanVertex[i] = topo.fanVertex[g];
+                for(int l=0;l<2*(groupOffset[g+1]-groupOffset[g]);l++){
+                    topo.fanTriangle[2*newOffset[i]+l] = topo.fanTriangle[2*groupOffset[g]+l];
                 }
-                if(isGood) goodList.push_back(i);
-            }
-            vertexList.resize(goodList.size());
-            for(int i=0;i<goodList.size();i++){
-                vertexList[i] = oldVertexList[goodList[i]];
             }
+            topo.fanVertex.resize(numGood);
+            topo.fanTriangle.resize(2*newOffset[numGood]);
+            topo.fanOffset.swap(newOffset);
         }
-        return makeTetList(tetMode, numPts, faceList, edgeList, vertexList, tetList);
+        return makeTetList(tetMode, numPts, topo, tetList);
     }
     
     // compute tet position to be used by weighting and constraint
@@ -475,14 +738,17 @@ namespace Tetrise{
         int numTet = (int)tetList.size()/4;
         tetCenter.resize(numTet);
         if(tetMode == TM_FACE ){
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 tetCenter[i]=(pts[tetList[4*i]]+pts[tetList[4*i+1]]+pts[tetList[4*i+2]])/3;
             }
         }else if(tetMode == TM_EDGE){
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 tetCenter[i]=(pts[tetList[4*i]]+pts[tetList[4*i+1]])/2;
             }
         }else if(tetMode == TM_VERTEX || tetMode == TM_VFACE){
+#pragma omp parallel for
             for(int i=0;i<numTet;i++){
                 tetCenter[i]=pts[tetList[4*i]];
             }